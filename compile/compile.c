@@ -220,6 +220,8 @@ static void WriteOpcodeShortOperand(CompileUnit *cu, OpCode opcode, int operand)
 */
 static uint32_t AddConstant(CompileUnit *cu, Value constant)
 {
+    // 字符串常量驻留，相同的字面量只保留一份
+    constant = InternValue(cu->curParser->vm, constant);
     ValueBufferAdd(cu->curParser->vm, &cu->compileUnitFn->constants, constant);
     return cu->compileUnitFn->constants.count - 1;
 }
@@ -1048,10 +1050,9 @@ static void ID(CompileUnit *cu, boolean canAssign)
         }
         // 按照静态域查找
         if (classBK != NULL) {
-            char *staticFieldId = ALLOCATE_ARRAY(cu->curParser->vm, char, MAX_ID_LEN);
-            memset(staticFieldId, 0, MAX_ID_LEN);
+            char staticFieldId[MAX_ID_LEN] = { '\0' };
             uint32_t staticFieldIdLen;
-            char* clsName = classBK->name->value.start;
+            char* clsName = STRING_START(classBK->name);
             uint32_t clsLen = classBK->name->value.length;
             memmove(staticFieldId, "Cls", 3);
             // TODO:
@@ -1062,7 +1063,6 @@ static void ID(CompileUnit *cu, boolean canAssign)
             memmove(staticFieldId + 4 + clsLen, tkName, tkLen);
             staticFieldIdLen = strlen(staticFieldId);
             var = GetVarFromLocalOrUpvalue(cu, staticFieldId, staticFieldIdLen);
-            DEALLOCATE_ARRAY(cu->curParser->vm, staticFieldId, MAX_ID_LEN);
             if (var.index != -1) {
                 EmitLoadOrStoreVariable(cu, canAssign, var);
                 return ;
@@ -1113,22 +1113,24 @@ static void StringInterpolation(CompileUnit *cu, boolean canAssign UNUSED)
     /**
      * a%(b+c) d%(e) f
      * 会按照如下形式编译
-     * ["a", b+c, "d",e,"f"].join()
+     * StringBuilder.new().append("a").append((b+c).toString).append("d").append(e.toString).append("f").toString
      * a和d是TOKEN_INTERPOLATION bcd都是TOKEN)ID f是TOKEN_STRING
+     * 片段在toString时一次拼接，不产生中间字符串
     */
-   EmitLoadModuleVar(cu, "List");
+   EmitLoadModuleVar(cu, "StringBuilder");
    EmitCall(cu, 0, "new()", 5);
    // 每次处理字符串中的一个内嵌表达式
    do {
         Literal(cu, false); // 
-        EmitCall(cu, 1, "addCore_(_)", 11);
+        EmitCall(cu, 1, "append(_)", 9);
         Expression(cu, BP_LOWEST);
-        EmitCall(cu, 1, "addCore_(_)", 11);
+        EmitCall(cu, 0, "toString", 8);
+        EmitCall(cu, 1, "append(_)", 9);
    } while (MatchToken(cu->curParser, TOKEN_INTERPOLATION));
    ConsumeCurToken(cu->curParser, TOKEN_STRING, "expect string at the end of interpolatation");
    Literal(cu, false);
-   EmitCall(cu, 1, "addCore_(_)", 11);
-   EmitCall(cu, 0, "join()", 6);
+   EmitCall(cu, 1, "append(_)", 9);
+   EmitCall(cu, 0, "toString", 8);
 }
 
 /**
@@ -1358,10 +1360,9 @@ static void CompileVarDefinition(CompileUnit *cu, boolean isStatic)
     // 当编译器编译类时，便会把enclosingClassBK置为当前classBK
     if (cu->enclosingUnit == NULL && cu->enclosingClassBK != NULL) {
         if (isStatic) { // 按照静态域
-            char *staticFieldId = ALLOCATE_ARRAY(cu->curParser->vm, char, MAX_ID_LEN);
-            memset(staticFieldId, 0, MAX_ID_LEN);
+            char staticFieldId[MAX_ID_LEN] = { '\0' };
             uint32_t staticFieldIdLen;
-            char *clsName = cu->enclosingClassBK->name->value.start;
+            char *clsName = STRING_START(cu->enclosingClassBK->name);
             uint32_t clsLen = cu->enclosingClassBK->name->value.length;
             // 用前缀'cls+类名+变量名'作为静态域在模块编译单元中的局部变量
             // 将静态域看做是模块的局部变量，为了解决多个类的静态域变量同名问题，故采用cls+类名+变量名的格式
@@ -1373,7 +1374,10 @@ static void CompileVarDefinition(CompileUnit *cu, boolean isStatic)
             memmove(staticFieldId + 4 + clsLen, tkName, tkLen);
             staticFieldIdLen = strlen(staticFieldId);
             if (FindLocal(cu, staticFieldId, staticFieldIdLen) == -1) {
-                int index = DeclareLocalVar(cu, staticFieldId, staticFieldIdLen);
+                // 局部变量只记下名字的地址，名字须活到模块编译完，按实际长度存入arena
+                char *localName = ArenaAlloc(cu->curParser->arena, staticFieldIdLen + 1);
+                memcpy(localName, staticFieldId, staticFieldIdLen + 1);
+                int index = DeclareLocalVar(cu, localName, staticFieldIdLen);
                 WriteOpcode(cu, OPCODE_PUSH_NULL);
                 ASSERT(cu->scopeDepth == 0, "should in class scope!");
                 DefineVariable(cu, index);
@@ -1391,7 +1395,10 @@ static void CompileVarDefinition(CompileUnit *cu, boolean isStatic)
             ClassBookKeep *classBK = GetEnclosingClassBK(cu);  // 返回cu的bk
             int fieldIndex = GetIndexFromSymbolTable(&classBK->fields, name.start, name.length);
             if (fieldIndex == -1) {
-                fieldIndex = AddSymbol(cu->curParser->vm, &classBK->fields, name.start, name.length);
+                // 域名只在编译期用到，放在竞技场中
+                String field = { ArenaStrndup(cu->curParser->arena, name.start, name.length), name.length };
+                ARENA_BUFFER_ADD(cu->curParser->arena, &classBK->fields, field);
+                fieldIndex = classBK->fields.count - 1;
             } else {
                 if (fieldIndex > MAX_FIELD_NUM) {
                     COMPILE_ERROR(cu->curParser, "the max number of instance field is %d!", MAX_FIELD_NUM);
@@ -1759,12 +1766,12 @@ static int DeclareMethod(CompileUnit *cu, char *signStr, uint32_t length)
     uint32_t idx = 0;
     while (idx < methods->count) {
         if (methods->datas[idx] == index) {
-            COMPILE_ERROR(cu->curParser, "repeat define method %s in class %s!", signStr, cu->enclosingClassBK->name->value.start);
+            COMPILE_ERROR(cu->curParser, "repeat define method %s in class %s!", signStr, STRING_START(cu->enclosingClassBK->name));
         }
         idx ++;
     }
     // 若是新定义就加入，这里并不是注册新方法
-    IntegerBufferAdd(cu->curParser->vm, methods, index);
+    ARENA_BUFFER_ADD(cu->curParser->arena, methods, index);
     return index;
 }
 
@@ -1896,7 +1903,7 @@ static void CompileClassDefinition(CompileUnit *cu)
     // 类名存入objModule.moduleVarName
     classVar.index = DeclareVariable(cu, cu->curParser->preToken.start, cu->curParser->preToken.length);
     // 生成类名，用于创建类
-    ObjString *className = NewObjString(cu->curParser->vm, cu->curParser->preToken.start, cu->curParser->preToken.length);
+    ObjString *className = InternString(cu->curParser->vm, cu->curParser->preToken.start, cu->curParser->preToken.length);
     // 生成加载类名的指令
     EmitLoadConstant(cu, OBJ_TO_VALUE(className));
     if (MatchToken(cu->curParser, TOKEN_LESS)) { // 类继承
@@ -1931,9 +1938,7 @@ static void CompileClassDefinition(CompileUnit *cu)
     }
     // 之前临时写了255个字段，现在回填
     cu->compileUnitFn->instructStream.datas[fieldNumIndex] = classBK.fields.count;
-    SymbolTableClear(cu->curParser->vm, &classBK.fields);
-    IntegerBufferClear(cu->curParser->vm, &classBK.instantMethods);
-    IntegerBufferClear(cu->curParser->vm, &classBK.staticMethods);
+    // classBK中的表都在竞技场中，随模块编译结束一起释放
     //enclosingClassBK用来表示是否正在编译类
     cu->enclosingClassBK = NULL;
     // 退出作用域，丢弃相关局部变量
@@ -1997,7 +2002,7 @@ static void CompileImport(CompileUnit *cu)
         GetNextToken(cu->curParser);
     }
     // 把模块名转为字符串，存储为常量
-    ObjString *moduleName = NewObjString(cu->curParser->vm, moduleNameToken.start, moduleNameToken.length);
+    ObjString *moduleName = InternString(cu->curParser->vm, moduleNameToken.start, moduleNameToken.length);
     uint32_t constModIdx = AddConstant(cu, OBJ_TO_VALUE(moduleName));
     /**import foo
      * 实际形式：System.importModule("foo")
@@ -2022,7 +2027,7 @@ static void CompileImport(CompileUnit *cu)
         // 在本模块中声明导入的模块变量
         uint32_t var_idx = DeclareVariable(cu, cu->curParser->preToken.start, cu->curParser->preToken.length);
         // 把模块变量转为字符串，存储为常量
-        ObjString *constVarName = NewObjString(cu->curParser->vm, cu->curParser->preToken.start, cu->curParser->preToken.length);
+        ObjString *constVarName = InternString(cu->curParser->vm, cu->curParser->preToken.start, cu->curParser->preToken.length);
         uint32_t constVarIdx = AddConstant(cu, OBJ_TO_VALUE(constVarName));
         // 为了调用System.getModuleVariable("foo", "bar1") 压入system
         EmitLoadModuleVar(cu, "System");
@@ -2094,6 +2099,9 @@ ObjFn* CompileModule(VM *vm, ObjModule *objModule, const char *moduleCore)
     // 各源码模块文件需要单独的parser 分配一个parser
     Parser parser;
     parser.parent = vm->curParser;
+    // 编译期的临时数据不经过MemManager，不计入GC的内存统计
+    Arena arena;
+    InitArena(&arena);
     // TODO: 局部变量带出去，当出栈时，该变量会被释放
     vm->curParser = &parser;
 
@@ -2103,8 +2111,9 @@ ObjFn* CompileModule(VM *vm, ObjModule *objModule, const char *moduleCore)
         // 与BuildCore内容基本相同，不同的是此处用脚本文件实现
         InitParser(vm, &parser, "core.script.inc", moduleCore, objModule);
     } else {
-        InitParser(vm, &parser,  (const char *)objModule->name->value.start, moduleCore, objModule);
+        InitParser(vm, &parser,  (const char *)STRING_START(objModule->name), moduleCore, objModule);
     }
+    parser.arena = &arena;
     
     // 初始化一个compileUnit
     CompileUnit moduleCu;
@@ -2130,10 +2139,12 @@ ObjFn* CompileModule(VM *vm, ObjModule *objModule, const char *moduleCore)
     vm->curParser->curCompileUnit = NULL;
     vm->curParser = vm->curParser->parent; // 回到父解析器
 #ifdef DEBUG
-    return EndCompileUnit(&moduleCu, "(script)", 8);
+    ObjFn *fn = EndCompileUnit(&moduleCu, "(script)", 8);
 #else
-    return EndCompileUnit(&moduleCu);
+    ObjFn *fn = EndCompileUnit(&moduleCu);
 #endif
+    FreeArena(&arena);
+    return fn;
 }
 
 //标识compileUnit使用的所有堆分配的对象(及其所有父对象)可达,以使它们不被GC收集
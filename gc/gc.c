@@ -2,6 +2,12 @@
 #include "compile.h"
 #include "obj_list.h"
 #include "obj_range.h"
+#include "obj_string.h"
+#include "parser.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
 #if DEBUG
    #include "debug.h"
    #include <time.h>
@@ -10,11 +16,9 @@
 //标灰obj:即把obj收集到数组vm->grays.grayObjects
 void GrayObject(VM* vm, ObjHeader* obj)
 {
-   //如果isDark为true表示为黑色,说明已经可达,直接返回
-   if (obj == NULL || obj->isdark) return;
-
-   //标记为可达
-   obj->isdark = true; 
+   //标记位已置位表示为黑色,说明已经可达,直接返回
+   //否则置位标记为可达
+   if (obj == NULL || HeapMark(obj)) return;
 
    //若超过了容量就扩容
    if (vm->grays.count >= vm->grays.capacity) {
@@ -37,250 +41,495 @@ void GrayValue(VM* vm, Value value)
    GrayObject(vm, VALUE_TO_OBJ(value));
 }
 
+//标记者:持有自己的灰色对象栈,并行标记时每个线程一个
+typedef struct markerGroup MarkerGroup;
+typedef struct marker {
+   uint32_t id;
+   Gray grays; //灰色对象栈,主人从顶部(count端)存取
+   uint32_t head; //其他marker从底部(head端)窃取
+   pthread_spinlock_t lock;
+   boolean parallel;
+   uint64_t liveBytes; //本marker标黑的对象所占空间
+   GCTypeStats live[GC_OBJ_TYPE_NUM]; //本marker标黑的各类型对象统计
+   MarkerGroup* group;
+} Marker;
+
+struct markerGroup {
+   Marker markers[MAX_MARK_THREADS];
+   uint32_t markerNum;
+   uint32_t idleNum; //空闲的marker数
+};
+
+//把obj压入marker的灰色栈
+static void PushGray(Marker* marker, ObjHeader* obj) {
+   if (marker->grays.count >= marker->grays.capacity) {
+      uint32_t newCapacity = marker->grays.capacity == 0 ? 32 : marker->grays.capacity * 2;
+      ObjHeader** newGrays = (ObjHeader**)realloc(marker->grays.grayObjects, newCapacity * sizeof(ObjHeader*));
+      if (newGrays == NULL) {
+         MEM_ERROR("Allocate gray stack failed!");
+      }
+      marker->grays.grayObjects = newGrays;
+      marker->grays.capacity = newCapacity;
+   }
+   marker->grays.grayObjects[marker->grays.count++] = obj;
+}
+
+//标灰obj,并行时用原子操作置标记位,保证每个对象只被一个marker标灰
+static void MarkObject(Marker* marker, ObjHeader* obj) {
+   if (obj == NULL) {
+      return;
+   }
+   if (marker->parallel) {
+      if (HeapMarkAtomic(obj)) {
+         return;
+      }
+      pthread_spin_lock(&marker->lock);
+      PushGray(marker, obj);
+      pthread_spin_unlock(&marker->lock);
+   } else {
+      if (HeapMark(obj)) {
+         return;
+      }
+      PushGray(marker, obj);
+   }
+}
+
+//标灰value
+static void MarkValue(Marker* marker, Value value) {
+   if (VALUE_IS_OBJ(value)) {
+      MarkObject(marker, VALUE_TO_OBJ(value));
+   }
+}
+
 //标灰buffer->datas中的value
-static void GrayBuffer(VM* vm, ValueBuffer* buffer)
+static void MarkBuffer(Marker* marker, ValueBuffer* buffer)
 {
    uint32_t idx = 0;
    while (idx < buffer->count) {
-      GrayValue(vm, buffer->datas[idx]);
+      MarkValue(marker, buffer->datas[idx]);
       idx++;
    }
 }
 
 //标黑class
-static void BlackClass(VM* vm, Class* class) {
+static void BlackClass(Marker* marker, Class* class) {
    //标灰meta类
-   GrayObject(vm, (ObjHeader*)class->objHeader.class);
+   MarkObject(marker, (ObjHeader*)OBJ_CLASS(class));
 
    //标灰父类
-   GrayObject(vm, (ObjHeader*)class->superClass);
+   MarkObject(marker, (ObjHeader*)class->superClass);
 
    //标灰方法
    uint32_t idx = 0;
    while (idx < class->methods.count) {
         if (class->methods.datas[idx].type == MT_SCRIPT) {
-	        GrayObject(vm, (ObjHeader*)class->methods.datas[idx].obj);
+	        MarkObject(marker, (ObjHeader*)class->methods.datas[idx].obj);
         }
         idx++;
    }
 
    //标灰类名
-    GrayObject(vm, (ObjHeader*)class->name);
+    MarkObject(marker, (ObjHeader*)class->name);
 
    //累计类大小
-   vm->allocatedBytes += sizeof(Class);
-   vm->allocatedBytes += sizeof(Method) * class->methods.capacity;
+   marker->liveBytes += sizeof(Class);
+   marker->liveBytes += sizeof(Method) * class->methods.capacity;
 }
 
 //标灰闭包
-static void BlackClosure(VM* vm, ObjClosure* objClosure) {
+static void BlackClosure(Marker* marker, ObjClosure* objClosure) {
    //标灰闭包中的函数
-   GrayObject(vm, (ObjHeader*)objClosure->fn);
+   MarkObject(marker, (ObjHeader*)objClosure->fn);
 
    //标灰包中的upvalue
    uint32_t idx = 0;
    while (idx < objClosure->fn->upvalueNum) {
-        GrayObject(vm, (ObjHeader*)objClosure->upvalues[idx]);
+        MarkObject(marker, (ObjHeader*)objClosure->upvalues[idx]);
         idx++;
    }
 
    //累计闭包大小
-   vm->allocatedBytes += sizeof(ObjClosure);
-   vm->allocatedBytes += sizeof(ObjUpvalue*) * objClosure->fn->upvalueNum;
+   marker->liveBytes += sizeof(ObjClosure);
+   marker->liveBytes += sizeof(ObjUpvalue*) * objClosure->fn->upvalueNum;
 }
 
 //标黑objThread
-static void BlackThread(VM* vm, ObjThread* objThread) {
+static void BlackThread(Marker* marker, ObjThread* objThread) {
    //标灰frame
    uint32_t idx = 0;
    while (idx < objThread->usedFrameNum) {
-      GrayObject(vm, (ObjHeader*)objThread->frames[idx].closure);
+      MarkObject(marker, (ObjHeader*)objThread->frames[idx].closure);
       idx++;
    }
 
    //标灰运行时栈中每个slot
    Value* slot =  objThread->stack;
    while (slot < objThread->esp) {
-      GrayValue(vm, *slot);
+      MarkValue(marker, *slot);
       slot++; 
    }
 
    //标灰本线程中所有的upvalue
    ObjUpvalue* upvalue = objThread->openUpvalues;
    while (upvalue != NULL) {
-      GrayObject(vm, (ObjHeader*)upvalue);
+      MarkObject(marker, (ObjHeader*)upvalue);
       upvalue = upvalue->next;
    }
 
    //标灰caller
-   GrayObject(vm, (ObjHeader*)objThread->caller);
-   GrayValue(vm, objThread->errorObj);
+   MarkObject(marker, (ObjHeader*)objThread->caller);
+   MarkValue(marker, objThread->errorObj);
 
    //累计线程大小
-   vm->allocatedBytes += sizeof(ObjThread);
-   vm->allocatedBytes += objThread->frameCapacity * sizeof(Frame);
-   vm->allocatedBytes += objThread->stackCapacity * sizeof(Value);
+   marker->liveBytes += sizeof(ObjThread);
+   marker->liveBytes += objThread->frameCapacity * sizeof(Frame);
+   marker->liveBytes += objThread->stackCapacity * sizeof(Value);
 }
 
 //标黑fn
-static void BlackFn(VM* vm, ObjFn* fn) {
+static void BlackFn(Marker* marker, ObjFn* fn) {
    //标灰常量
-   GrayBuffer(vm, &fn->constants);
+   MarkBuffer(marker, &fn->constants);
 
    //累计Objfn的空间
-   vm->allocatedBytes += sizeof(ObjFn);
-   vm->allocatedBytes += sizeof(uint8_t) * fn->instructStream.capacity;
-   vm->allocatedBytes += sizeof(Value) * fn->constants.capacity;
+   marker->liveBytes += sizeof(ObjFn);
+   marker->liveBytes += sizeof(uint8_t) * fn->instructStream.capacity;
+   marker->liveBytes += sizeof(Value) * fn->constants.capacity;
   
 #if DEBUG  
    //再加上debug信息占用的内存
-   vm->allocatedBytes += sizeof(Int) * fn->instrStream.capacity;
+   marker->liveBytes += sizeof(Int) * fn->instrStream.capacity;
 #endif  
 }
 
 //标黑objInstance
-static void BlackInstance(VM* vm, ObjInstance* objInstance) {
+static void BlackInstance(Marker* marker, ObjInstance* objInstance) {
    //标灰元类
-   GrayObject(vm, (ObjHeader*)objInstance->objHeader.class);
+   MarkObject(marker, (ObjHeader*)OBJ_CLASS(objInstance));
 
    //标灰实例中所有域,域的个数在class->fieldNum
    uint32_t idx = 0;
-   while (idx < objInstance->objHeader.class->fieldNum) {
-      GrayValue(vm, objInstance->fields[idx]);
+   while (idx < OBJ_CLASS(objInstance)->fieldNum) {
+      MarkValue(marker, objInstance->fields[idx]);
       idx++;
    }
 
    //累计objInstance空间
-   vm->allocatedBytes += sizeof(ObjInstance);
-   vm->allocatedBytes += sizeof(Value) * objInstance->objHeader.class->fieldNum;
+   marker->liveBytes += sizeof(ObjInstance);
+   marker->liveBytes += sizeof(Value) * OBJ_CLASS(objInstance)->fieldNum;
 }
 
 //标黑objList
-static void BlackList(VM* vm, ObjList* objList) {
+static void BlackList(Marker* marker, ObjList* objList) {
    //标灰list的elements
-   GrayBuffer(vm, &objList->elements);
+   MarkBuffer(marker, &objList->elements);
 
    //累计objList大小
-   vm->allocatedBytes += sizeof(ObjList);
-   vm->allocatedBytes += sizeof(Value) * objList->elements.capacity;
+   marker->liveBytes += sizeof(ObjList);
+   marker->liveBytes += sizeof(Value) * objList->elements.capacity;
 }
 
 //标黑objMap
-static void BlackMap(VM* vm, ObjMap* objMap) {
-   //标灰所有entry
+static void BlackMap(Marker* marker, ObjMap* objMap) {
+   //标灰所有在用的key和value,集合只有key
    uint32_t idx = 0;
-   while (idx < objMap->capacity) {
-      Entry* entry = &objMap->entries[idx];
-      //跳过无效的entry
-      if (!VALUE_IS_UNDEFINED(entry->key)) {
-        GrayValue(vm, entry->key);
-        GrayValue(vm, entry->value);
+   while (idx < objMap->entryCount) {
+      //跳过删除留下的空位
+      if (MAP_ENTRY_IS_LIVE(objMap, idx)) {
+        MarkValue(marker, MAP_ENTRY_KEY(objMap, idx));
+        if (objMap->values != NULL) {
+           MarkValue(marker, objMap->values[idx]);
+        }
       }
       idx++;
    }
 
    //累计ObjMap大小
-   vm->allocatedBytes += sizeof(ObjMap);
-   vm->allocatedBytes += sizeof(Entry) * objMap->capacity;
+   marker->liveBytes += sizeof(ObjMap);
+   marker->liveBytes += MapStorageSize(objMap);
 }
 
 //标黑objModule
-static void BlackModule(VM* vm, ObjModule* objModule) {
+static void BlackModule(Marker* marker, ObjModule* objModule) {
    //标灰模块中所有模块变量
    uint32_t idx = 0;
    while (idx < objModule->moduleVarValue.count) {
-      GrayValue(vm, objModule->moduleVarValue.datas[idx]);
+      MarkValue(marker, objModule->moduleVarValue.datas[idx]);
       idx++;
    }
 
    //标灰模块名
-   GrayObject(vm, (ObjHeader*)objModule->name);
+   MarkObject(marker, (ObjHeader*)objModule->name);
 
    //累计ObjModule大小
-   vm->allocatedBytes += sizeof(ObjModule);
-   vm->allocatedBytes += sizeof(String) * objModule->moduleVarName.capacity;
-   vm->allocatedBytes += sizeof(Value) * objModule->moduleVarValue.capacity;
+   marker->liveBytes += sizeof(ObjModule);
+   marker->liveBytes += sizeof(String) * objModule->moduleVarName.capacity;
+   marker->liveBytes += sizeof(Value) * objModule->moduleVarValue.capacity;
 }
 
 //标黑range
-static void BlackRange(VM* vm) {
+static void BlackRange(Marker* marker) {
    //ObjRange中没有大数据,只有from和to,
    //其空间属于sizeof(ObjRange),因此不用额外标记
-   vm->allocatedBytes += sizeof(ObjRange);
+   marker->liveBytes += sizeof(ObjRange);
 }
 
 //标黑objString
-static void BlackString(VM* vm, ObjString* objString) {
+static void BlackString(Marker* marker, ObjString* objString) {
+   //切片的内容在父串中,父串要随切片保留
+   if (STRING_IS_SLICE(objString)) {
+      MarkObject(marker, (ObjHeader*)STRING_AS_SLICE(objString)->parent);
+      marker->liveBytes += sizeof(ObjStringSlice);
+      return;
+   }
+   //具体化后的切片另有单独的缓冲区
+   if (objString->isSlice) {
+      marker->liveBytes += sizeof(ObjStringSlice) + objString->value.length + 1;
+      return;
+   }
    //累计ObjString空间 +1是结尾的'\0'
-   vm->allocatedBytes += sizeof(ObjString) + objString->value.length + 1;
+   marker->liveBytes += sizeof(ObjString) + objString->value.length + 1;
 }
 
 //标黑objUpvalue
-static void BlackUpvalue(VM* vm, ObjUpvalue* objUpvalue) {
+static void BlackUpvalue(Marker* marker, ObjUpvalue* objUpvalue) {
    //标灰objUpvalue的closedUpvalue
-   GrayValue(vm, objUpvalue->closedUpvalue);
+   MarkValue(marker, objUpvalue->closedUpvalue);
 
    //累计objUpvalue大小
-   vm->allocatedBytes += sizeof(ObjUpvalue);
+   marker->liveBytes += sizeof(ObjUpvalue);
 }
 
 //标黑obj
-static void BlackObject(VM* vm, ObjHeader* obj) {
+static void BlackObject(Marker* marker, ObjHeader* obj) {
 #ifdef DEBUG
    printf("mark ");
    DumpValue(OBJ_TO_VALUE(obj));
    printf(" @ %p\n", obj);
 #endif
+   ObjType type = OBJ_TYPE(obj);
+   marker->live[type].objectNum++;
+   marker->live[type].bytes += HEAP_PAGE_OF(obj)->slotSize;
+
 //根据对象类型分别标黑
-   switch (obj->type) {
+   switch (type) {
         case OT_CLASS:
-	        BlackClass(vm, (Class*)obj);
+	        BlackClass(marker, (Class*)obj);
 	        break;
         case OT_CLOSURE:
-            BlackClosure(vm, (ObjClosure*)obj);
+            BlackClosure(marker, (ObjClosure*)obj);
             break;
         case OT_THREAD:
-            BlackThread(vm, (ObjThread*)obj);
+            BlackThread(marker, (ObjThread*)obj);
             break;
         case OT_FUNCTION:
-            BlackFn(vm, (ObjFn*)obj);
+            BlackFn(marker, (ObjFn*)obj);
             break;
         case OT_INSTANCE:
-            BlackInstance(vm, (ObjInstance*)obj);
+            BlackInstance(marker, (ObjInstance*)obj);
             break;
         case OT_LIST:
-            BlackList(vm, (ObjList*)obj);
+            BlackList(marker, (ObjList*)obj);
             break;
         case OT_MAP:
-            BlackMap(vm, (ObjMap*)obj);
+        case OT_SET:
+            BlackMap(marker, (ObjMap*)obj);
             break;
         case OT_MODULE:
-            BlackModule(vm, (ObjModule*)obj);
+            BlackModule(marker, (ObjModule*)obj);
             break;
         case OT_RANGE:
-            BlackRange(vm);
+            BlackRange(marker);
             break;
         case OT_STRING:
-            BlackString(vm, (ObjString*)obj);
+            BlackString(marker, (ObjString*)obj);
             break;
         case OT_UPVALUE: 
-            BlackUpvalue(vm, (ObjUpvalue*)obj);
+            BlackUpvalue(marker, (ObjUpvalue*)obj);
             break;
    }
 }
 
+//从marker自己的灰色栈顶部取出一个对象,没有则返回NULL
+static ObjHeader* PopGray(Marker* marker) {
+   ObjHeader* obj = NULL;
+   if (marker->parallel) {
+      pthread_spin_lock(&marker->lock);
+   }
+   if (marker->grays.count > marker->head) {
+      obj = marker->grays.grayObjects[--marker->grays.count];
+      if (marker->grays.count == marker->head) {
+         marker->grays.count = marker->head = 0;
+      }
+   }
+   if (marker->parallel) {
+      pthread_spin_unlock(&marker->lock);
+   }
+   return obj;
+}
+
+//从其他marker的灰色栈底部窃取一个对象,没有则返回NULL
+static ObjHeader* StealGray(Marker* thief) {
+   MarkerGroup* group = thief->group;
+   uint32_t idx = 1;
+   while (idx < group->markerNum) {
+      Marker* victim = &group->markers[(thief->id + idx) % group->markerNum];
+      ObjHeader* obj = NULL;
+      pthread_spin_lock(&victim->lock);
+      if (victim->grays.count > victim->head) {
+         obj = victim->grays.grayObjects[victim->head++];
+         if (victim->head == victim->grays.count) {
+            victim->grays.count = victim->head = 0;
+         }
+      }
+      pthread_spin_unlock(&victim->lock);
+      if (obj != NULL) {
+         return obj;
+      }
+      idx++;
+   }
+   return NULL;
+}
+
+//是否还有marker的灰色栈中有对象
+static boolean HasGray(MarkerGroup* group) {
+   uint32_t idx = 0;
+   while (idx < group->markerNum) {
+      Marker* marker = &group->markers[idx];
+      pthread_spin_lock(&marker->lock);
+      boolean hasGray = marker->grays.count > marker->head;
+      pthread_spin_unlock(&marker->lock);
+      if (hasGray) {
+         return true;
+      }
+      idx++;
+   }
+   return false;
+}
+
 //标黑那些已经标灰的对象,即保留那些标灰的对象
+//并行时自己的栈空了就去别人那里窃取,所有marker都空闲时标记结束
+static void DrainGrays(Marker* marker) {
+   while (true) {
+      ObjHeader* objHeader = PopGray(marker);
+      if (objHeader == NULL && marker->parallel) {
+         objHeader = StealGray(marker);
+      }
+      if (objHeader != NULL) {
+         BlackObject(marker, objHeader);
+         continue;
+      }
+      if (!marker->parallel) {
+         return;
+      }
+
+      //进入空闲.空闲marker的栈必然为空,
+      //因此全部空闲时不会再有对象被标灰
+      MarkerGroup* group = marker->group;
+      __atomic_add_fetch(&group->idleNum, 1, __ATOMIC_SEQ_CST);
+      while (true) {
+         if (__atomic_load_n(&group->idleNum, __ATOMIC_SEQ_CST) == group->markerNum) {
+            return;
+         }
+         if (HasGray(group)) {
+            __atomic_sub_fetch(&group->idleNum, 1, __ATOMIC_SEQ_CST);
+            break;
+         }
+         sched_yield();
+      }
+   }
+}
+
+static void* MarkerThread(void* arg) {
+   DrainGrays((Marker*)arg);
+   return NULL;
+}
+
+//把marker统计的存活信息汇总到vm
+static void MergeMarkerStats(VM* vm, Marker* marker) {
+   vm->allocatedBytes += marker->liveBytes;
+   uint32_t idx = 0;
+   while (idx < GC_OBJ_TYPE_NUM) {
+      vm->gcStats.live[idx].objectNum += marker->live[idx].objectNum;
+      vm->gcStats.live[idx].bytes += marker->live[idx].bytes;
+      idx++;
+   }
+}
+
+//单线程标黑vm->grays中的对象
 static void BlackObjectInGray(VM* vm) {
-//所有要保留的对象都已经收集到了vm->grays.grayObjects中,
-//现在逐一标黑
-   while (vm->grays.count > 0) {
-      ObjHeader* objHeader = vm->grays.grayObjects[--vm->grays.count];
-      BlackObject(vm, objHeader);
+   Marker marker;
+   memset(&marker, 0, sizeof(Marker));
+   marker.parallel = false;
+   marker.grays = vm->grays;
+   DrainGrays(&marker);
+   vm->grays = marker.grays; //灰色栈可能扩容过
+   MergeMarkerStats(vm, &marker);
+}
+
+//多线程标黑vm->grays中的对象,根对象平均分给各marker
+static void ParallelBlackObjectInGray(VM* vm, uint32_t markerNum) {
+   MarkerGroup group;
+   group.markerNum = markerNum;
+   group.idleNum = 0;
+
+   uint32_t idx = 0;
+   while (idx < markerNum) {
+      Marker* marker = &group.markers[idx];
+      memset(marker, 0, sizeof(Marker));
+      marker->id = idx;
+      marker->parallel = true;
+      marker->group = &group;
+      marker->grays.count = 0;
+      marker->grays.capacity = vm->grays.capacity;
+      marker->grays.grayObjects = (ObjHeader**)malloc(marker->grays.capacity * sizeof(ObjHeader*));
+      if (marker->grays.grayObjects == NULL) {
+         MEM_ERROR("Allocate gray stack failed!");
+      }
+      pthread_spin_init(&marker->lock, PTHREAD_PROCESS_PRIVATE);
+      idx++;
+   }
+   idx = 0;
+   while (idx < vm->grays.count) {
+      Gray* grays = &group.markers[idx % markerNum].grays;
+      grays->grayObjects[grays->count++] = vm->grays.grayObjects[idx];
+      idx++;
+   }
+   vm->grays.count = 0;
+
+   //本线程充当0号marker
+   pthread_t threads[MAX_MARK_THREADS];
+   uint32_t spawned = 1;
+   while (spawned < markerNum) {
+      if (pthread_create(&threads[spawned], NULL, MarkerThread, &group.markers[spawned]) != 0) {
+         break;
+      }
+      spawned++;
+   }
+   //线程没能全部建起来时,没有线程的marker直接记为空闲,
+   //它们栈中的根对象由其他marker窃取完成
+   if (spawned < markerNum) {
+      __atomic_add_fetch(&group.idleNum, markerNum - spawned, __ATOMIC_SEQ_CST);
+   }
+   DrainGrays(&group.markers[0]);
+   idx = 1;
+   while (idx < spawned) {
+      pthread_join(threads[idx], NULL);
+      idx++;
+   }
+
+   idx = 0;
+   while (idx < markerNum) {
+      Marker* marker = &group.markers[idx];
+      MergeMarkerStats(vm, marker);
+      pthread_spin_destroy(&marker->lock);
+      free(marker->grays.grayObjects);
+      idx++;
    }
 }
 
-//释放obj自身及其占用的内存
-void FreeObject(VM* vm, ObjHeader* obj)
+//释放obj占用的附属内存,obj自身的slot由调用者回收
+static void FreeObjectContents(VM* vm, ObjHeader* obj)
 {
 #ifdef DEBUG 
    printf("free ");
@@ -289,7 +538,7 @@ void FreeObject(VM* vm, ObjHeader* obj)
 #endif
 
     //根据对象类型分别处理
-    switch (obj->type) { 
+    switch (OBJ_TYPE(obj)) { 
         case OT_CLASS:
 	        MethodBufferClear(vm, &((Class*)obj)->methods);
 	        break;
@@ -315,36 +564,64 @@ void FreeObject(VM* vm, ObjHeader* obj)
             ValueBufferClear(vm, &((ObjList*)obj)->elements);
             break;
         case OT_MAP:
-            DEALLOCATE(vm, ((ObjMap*)obj)->entries);
+        case OT_SET:
+            ClearMap(vm, (ObjMap*)obj);
             break;
         case OT_MODULE:
             StringBufferClear(vm, &((ObjModule*)obj)->moduleVarName);
             ValueBufferClear(vm, &((ObjModule*)obj)->moduleVarValue);
             break;
-        case OT_STRING:
+        case OT_STRING: {
+            //具体化后的切片内容在单独的缓冲区中
+            ObjString* objString = (ObjString*)obj;
+            if (objString->isSlice && STRING_AS_SLICE(objString)->parent == NULL) {
+               DEALLOCATE_ARRAY(vm, STRING_AS_SLICE(objString)->start, objString->value.length + 1);
+            }
+            break;
+        }
         case OT_RANGE:
         case OT_CLOSURE:
         case OT_INSTANCE:
         case OT_UPVALUE:
 	        break;
    }
+}
+
+//清扫时堆对每个垃圾对象的回调
+static void SweepObject(void* obj, void* vm) {
+   FreeObjectContents((VM*)vm, (ObjHeader*)obj);
+}
+
+//释放obj自身及其占用的内存
+void FreeObject(VM* vm, ObjHeader* obj)
+{
+   FreeObjectContents(vm, obj);
 
    //最后再释放自己
-   DEALLOCATE(vm, obj);
+   FreeObjectMemory(vm, obj);
+}
+
+//释放堆中全部对象的附属内存,对象本身随堆页一起归还
+void FreeAllObjects(VM* vm)
+{
+   HeapWalk(&vm->heap, SweepObject, vm);
 }
 
 //立即运行垃圾回收器去释放未用的内存
 void StartGC(VM* vm)
 {
+   uint64_t before = vm->allocatedBytes;
+   uint64_t markStart = GCStatsNowNs();
 #ifdef DEBUG 
    double startTime = (double)clock() / CLOCKS_PER_SEC;
-   uint32_t before = vm->allocatedBytes;
-   printf("-- gc  before:%d   nextGC:%d  vm:%p  --\n", before, vm->config.nextGC, vm);
+   printf("-- gc  before:%lu   nextGC:%lu  vm:%p  --\n",
+         (unsigned long)before, (unsigned long)vm->config.nextGC, vm);
 #endif
     // 一 标记阶段:标记需要保留的对象
 
    //将allocatedBytes置0便于精确统计回收后的总分配内存大小
    vm->allocatedBytes = 0;
+   memset(vm->gcStats.live, 0, sizeof(vm->gcStats.live));
 
   //allModules不能被释放
    GrayObject(vm, (ObjHeader*)vm->allModules);
@@ -356,6 +633,13 @@ void StartGC(VM* vm)
       idx++;
    }
 
+   //空串和单字节串常驻
+   idx = 0;
+   while (idx < SMALL_STRING_NUM) {
+      GrayObject(vm, (ObjHeader*)vm->smallStrings[idx]);
+      idx++;
+   }
+
    //标灰当前线程,不能被回收
    GrayObject(vm, (ObjHeader*)vm->curThread);
 
@@ -365,31 +649,52 @@ void StartGC(VM* vm)
 //         GrayCompileUnit(vm, vm->curParser->curCompileUnit);  
 //    }
 
-   //置黑所有灰对象(保留的对象)
-   BlackObjectInGray(vm);  
+   //置黑所有灰对象(保留的对象),堆足够大时多线程并行标记
+   if (vm->config.markThreads > 1 && vm->heap.pageNum >= PARALLEL_MARK_MIN_PAGES) {
+      uint32_t markerNum = vm->config.markThreads;
+      if (markerNum > MAX_MARK_THREADS) {
+         markerNum = MAX_MARK_THREADS;
+      }
+      ParallelBlackObjectInGray(vm, markerNum);
+   } else {
+      BlackObjectInGray(vm);
+   }
+
+   //驻留表弱引用其中的字符串,在清扫释放它们之前剔除未标记的
+   SweepStringTable(&vm->strings);
+
+   //标记阶段统计出的即是存活内存量,清扫时释放内存会从allocatedBytes中扣减,先记下
+   uint64_t liveBytes = vm->allocatedBytes;
+   uint64_t sweepStart = GCStatsNowNs();
 
     // 二 清扫阶段:回收白对象(垃圾对象)
 
-   ObjHeader** obj = &vm->allObjects;
-   while (*obj != NULL) { 
-        //回收白对象
-        if (!((*obj)->isdark)) {
-	        ObjHeader* unreached = *obj;
-	        *obj = unreached->next;
-	        FreeObject(vm, unreached);
-        } else {
-	        //如果已经是黑对象,为了下一次gc重新判定,
-	        //现在将其恢复为未标记状态,避免永远不被回收
-	        (*obj)->isdark = false;
-	        obj = &(*obj)->next;
-      }
-   }
+   //回收白对象,逐页按位图找出已分配而未标记的slot
+   HeapSweep(&vm->heap, SweepObject, vm);
+
+   //为了下一次gc重新判定,将黑对象恢复为未标记状态,避免永远不被回收
+   //标记位在页外的位图中,逐页清零即可,不必写每个对象
+   HeapClearMarks(&vm->heap);
 
-    //更新下一次触发gc的阀值
-    vm->config.nextGC = vm->allocatedBytes * vm->config.heapGrowthFactor;
+   vm->allocatedBytes = liveBytes;
+   vm->gcPending = false;
+   uint64_t sweepEnd = GCStatsNowNs();
+   GCStatsRecordGC(&vm->gcStats, sweepStart - markStart, sweepEnd - sweepStart, before, liveBytes);
+
+    //更新下一次触发gc的阀值,设置了堆上限时不超过上限
+    vm->config.nextGC = (uint64_t)(vm->allocatedBytes * vm->config.heapGrowthFactor);
     if (vm->config.nextGC < vm->config.minHeapSize) {
         vm->config.nextGC = vm->config.minHeapSize;
     }
+    if (vm->config.maxHeapSize != 0 && vm->config.nextGC > vm->config.maxHeapSize) {
+        vm->config.nextGC = vm->config.maxHeapSize;
+    }
+
+    //碎片过多时请求整理,整理要搬迁对象,只能等到安全点再做
+    if (vm->config.enableCompact &&
+          HeapFragmentation(&vm->heap) > vm->config.compactThreshold) {
+        vm->compactPending = true;
+    }
 
 #ifdef DEBUG
    double elapsed = ((double)clock() / CLOCKS_PER_SEC) - startTime;
@@ -400,4 +705,283 @@ void StartGC(VM* vm)
 	 (unsigned long)vm->config.nextGC,
 	 elapsed);
 #endif
-}
\ No newline at end of file
+}
+
+//取得obj搬迁后的地址,未搬迁的对象原样返回
+//被搬空页中的对象都已复制走,原slot的首个字存放着新地址
+static ObjHeader* Forward(ObjHeader* obj) {
+   if (obj != NULL && HEAP_PAGE_OF(obj)->evacuating) {
+      return *(ObjHeader**)obj;
+   }
+   return obj;
+}
+
+#define FORWARD_FIELD(field) ((field) = (typeof(field))Forward((ObjHeader*)(field)))
+
+//更新value中的对象引用
+static void ForwardValue(Value* value) {
+   if (VALUE_IS_OBJ(*value)) {
+      value->objHeader = Forward(value->objHeader);
+   }
+}
+
+//更新buffer->datas中的对象引用
+static void ForwardBuffer(ValueBuffer* buffer) {
+   uint32_t idx = 0;
+   while (idx < buffer->count) {
+      ForwardValue(&buffer->datas[idx]);
+      idx++;
+   }
+}
+
+//把搬空页中的存活对象复制到其他页,并在原slot留下新地址
+static void EvacuateObjects(VM* vm) {
+   uint32_t classIdx = 0;
+   while (classIdx < HEAP_SIZE_CLASS_NUM) {
+      HeapPage* page = vm->heap.pages[classIdx];
+      while (page != NULL) {
+         if (!page->evacuating) {
+            page = page->next;
+            continue;
+         }
+         uint32_t slotIdx = 0;
+         while (slotIdx < page->slotNum) {
+            if (((page->allocBits[slotIdx / 64] >> (slotIdx & 63)) & 1) == 0) {
+               slotIdx++;
+               continue;
+            }
+            ObjHeader* from = (ObjHeader*)(page->slots + (size_t)slotIdx * page->slotSize);
+            ObjHeader* to = (ObjHeader*)HeapAllocate(&vm->heap, page->slotSize);
+            if (to == NULL) {
+               MEM_ERROR("Allocate memory failed while compacting heap!");
+            }
+            memcpy(to, from, page->slotSize);
+
+            //已关闭的upvalue指向自身的closedUpvalue,要随对象一起改
+            if (OBJ_TYPE(from) == OT_UPVALUE) {
+               ObjUpvalue* upvalue = (ObjUpvalue*)from;
+               if (upvalue->localVarPtr == &upvalue->closedUpvalue) {
+                  ((ObjUpvalue*)to)->localVarPtr = &((ObjUpvalue*)to)->closedUpvalue;
+               }
+            }
+            *(ObjHeader**)from = to;
+            slotIdx++;
+         }
+         page = page->next;
+      }
+      classIdx++;
+   }
+}
+
+//更新obj中指向其他对象的引用
+static void ForwardObject(void* objPtr, void* arg UNUSED) {
+   ObjHeader* obj = (ObjHeader*)objPtr;
+   SET_OBJ_CLASS(obj, Forward((ObjHeader*)OBJ_CLASS(obj)));
+   switch (OBJ_TYPE(obj)) {
+      case OT_CLASS: {
+         Class* class = (Class*)obj;
+         FORWARD_FIELD(class->superClass);
+         FORWARD_FIELD(class->name);
+         uint32_t idx = 0;
+         while (idx < class->methods.count) {
+            if (class->methods.datas[idx].type == MT_SCRIPT) {
+               FORWARD_FIELD(class->methods.datas[idx].obj);
+            }
+            idx++;
+         }
+         break;
+      }
+      case OT_CLOSURE: {
+         ObjClosure* objClosure = (ObjClosure*)obj;
+         FORWARD_FIELD(objClosure->fn);
+         uint32_t idx = 0;
+         while (idx < objClosure->fn->upvalueNum) {
+            FORWARD_FIELD(objClosure->upvalues[idx]);
+            idx++;
+         }
+         break;
+      }
+      case OT_THREAD: {
+         ObjThread* objThread = (ObjThread*)obj;
+         uint32_t idx = 0;
+         while (idx < objThread->usedFrameNum) {
+            //frame.stackStart指向线程的运行时栈,栈本身不搬迁
+            FORWARD_FIELD(objThread->frames[idx].closure);
+            idx++;
+         }
+         Value* slot = objThread->stack;
+         while (slot < objThread->esp) {
+            ForwardValue(slot);
+            slot++;
+         }
+         FORWARD_FIELD(objThread->openUpvalues);
+         FORWARD_FIELD(objThread->caller);
+         ForwardValue(&objThread->errorObj);
+         break;
+      }
+      case OT_FUNCTION: {
+         ObjFn* fn = (ObjFn*)obj;
+         ForwardBuffer(&fn->constants);
+         FORWARD_FIELD(fn->module);
+         break;
+      }
+      case OT_INSTANCE: {
+         ObjInstance* objInstance = (ObjInstance*)obj;
+         uint32_t idx = 0;
+         while (idx < OBJ_CLASS(objInstance)->fieldNum) {
+            ForwardValue(&objInstance->fields[idx]);
+            idx++;
+         }
+         break;
+      }
+      case OT_LIST:
+         ForwardBuffer(&((ObjList*)obj)->elements);
+         break;
+      case OT_MAP:
+      case OT_SET: {
+         //key的哈希值只与内容有关,搬迁后不必重新散列
+         ObjMap* objMap = (ObjMap*)obj;
+         uint32_t idx = 0;
+         while (idx < objMap->entryCount) {
+            if (MAP_ENTRY_IS_LIVE(objMap, idx)) {
+               //数组模式下key是下标,不必更新
+               if (objMap->keys != NULL) {
+                  ForwardValue(&objMap->keys[idx]);
+               }
+               //集合在数组模式之外没有values
+               if (objMap->values != NULL) {
+                  ForwardValue(&objMap->values[idx]);
+               }
+            }
+            idx++;
+         }
+         break;
+      }
+      case OT_MODULE:
+         ForwardBuffer(&((ObjModule*)obj)->moduleVarValue);
+         FORWARD_FIELD(((ObjModule*)obj)->name);
+         break;
+      case OT_UPVALUE: {
+         ObjUpvalue* objUpvalue = (ObjUpvalue*)obj;
+         //localVarPtr指向运行时栈或自身的closedUpvalue,后者在搬迁时已改好
+         ForwardValue(&objUpvalue->closedUpvalue);
+         FORWARD_FIELD(objUpvalue->next);
+         break;
+      }
+      case OT_STRING: {
+         //切片指向父串的内容,父串搬迁后按原偏移改到新位置
+         //父串自身不是切片,内容紧跟在对象之后,原位置只用于计算偏移,不再读取
+         ObjString* objString = (ObjString*)obj;
+         if (STRING_IS_SLICE(objString)) {
+            ObjStringSlice* slice = STRING_AS_SLICE(objString);
+            ObjString* oldParent = slice->parent;
+            FORWARD_FIELD(slice->parent);
+            if (slice->parent != oldParent) {
+               slice->start = slice->parent->value.start + (slice->start - oldParent->value.start);
+            }
+         }
+         break;
+      }
+      case OT_RANGE:
+         break;
+   }
+}
+
+//更新vm中根对象的引用
+static void ForwardRoots(VM* vm) {
+   FORWARD_FIELD(vm->allModules);
+   FORWARD_FIELD(vm->curThread);
+   FORWARD_FIELD(vm->classOfClass);
+   FORWARD_FIELD(vm->objectClass);
+   FORWARD_FIELD(vm->mapClass);
+   FORWARD_FIELD(vm->setClass);
+   FORWARD_FIELD(vm->rangeClass);
+   FORWARD_FIELD(vm->listClass);
+   FORWARD_FIELD(vm->fnClass);
+   FORWARD_FIELD(vm->stringClass);
+   FORWARD_FIELD(vm->nullClass);
+   FORWARD_FIELD(vm->boolClass);
+   FORWARD_FIELD(vm->numClass);
+   FORWARD_FIELD(vm->threadClass);
+   FORWARD_FIELD(vm->stringBuilderClass);
+
+   uint32_t idx = 0;
+   while (idx < vm->tmpRootNum) {
+      FORWARD_FIELD(vm->tmpRoots[idx]);
+      idx++;
+   }
+
+   idx = 0;
+   while (idx < SMALL_STRING_NUM) {
+      FORWARD_FIELD(vm->smallStrings[idx]);
+      idx++;
+   }
+
+   //驻留表按hashCode定位,字符串搬迁后位置不变,改指针即可,墓碑跳过
+   idx = 0;
+   while (idx < vm->strings.capacity) {
+      if (STRING_TABLE_ENTRY_IS_LIVE(vm->strings.strings[idx])) {
+         FORWARD_FIELD(vm->strings.strings[idx]);
+      }
+      idx++;
+   }
+}
+
+//整理堆:先完整回收一次,再把稀疏页中的存活对象搬到一起并释放搬空的页
+//搬迁会使c代码中持有的对象指针失效,只能在解释器的安全点调用
+void CompactHeap(VM* vm)
+{
+   //编译过程中编译单元持有的对象不在根中,不能搬迁
+   if (vm->curParser != NULL) {
+      return;
+   }
+
+   StartGC(vm);
+   vm->compactPending = false;
+
+   uint64_t compactStart = GCStatsNowNs();
+   uint32_t evacuateNum = HeapSelectEvacuationPages(&vm->heap);
+   if (evacuateNum == 0) {
+      return;
+   }
+   EvacuateObjects(vm);
+
+   //经过上面的回收,堆中只剩存活对象,逐个更新其中的引用
+   HeapWalk(&vm->heap, ForwardObject, NULL);
+   ForwardRoots(vm);
+
+   HeapReleaseEvacuatedPages(&vm->heap);
+   GCStatsRecordCompact(&vm->gcStats, GCStatsNowNs() - compactStart, evacuateNum);
+}
+
+//在安全点处理挂起的GC和堆整理请求
+//GC后存活内存仍超过堆上限时,把错误记入当前线程的errorObj并返回false
+boolean GCSafepoint(VM* vm)
+{
+   //编译期间编译单元里的对象尚未入根,推迟到编译结束后
+   if (vm->curParser != NULL) {
+      return true;
+   }
+   //暂停GC期间只在超出堆上限时回收
+   boolean overLimit = vm->config.maxHeapSize != 0 && vm->allocatedBytes > vm->config.maxHeapSize;
+   if (vm->gcPauseDepth > 0 && !overLimit) {
+      return true;
+   }
+
+   //整理前本就会先GC一次
+   if (vm->gcPending && !vm->compactPending) {
+      StartGC(vm);
+   }
+   if (vm->compactPending) {
+      CompactHeap(vm);
+   }
+
+   if (vm->config.maxHeapSize != 0 && vm->allocatedBytes > vm->config.maxHeapSize) {
+      char msg[64];
+      int len = snprintf(msg, sizeof(msg), "out of memory: heap limit %lu bytes exceeded!",
+            (unsigned long)vm->config.maxHeapSize);
+      vm->curThread->errorObj = OBJ_TO_VALUE(NewObjString(vm, msg, len));
+      return false;
+   }
+   return true;
+}
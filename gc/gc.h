@@ -12,5 +12,8 @@ void GrayObject(VM* vm, ObjHeader* obj);
 void GrayValue(VM* vm, Value value);
 void StartGC(VM* vm);
 void FreeObject(VM* vm, ObjHeader* obj);
+void FreeAllObjects(VM* vm);
+void CompactHeap(VM* vm);
+boolean GCSafepoint(VM* vm);
 
 #endif // !__GC_GC_H__
\ No newline at end of file
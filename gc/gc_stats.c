@@ -0,0 +1,129 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-06 21:03:12
+ * @Description: GC统计
+ */
+#include "gc_stats.h"
+#include <string.h>
+#include <time.h>
+
+static const char *typeNames[GC_OBJ_TYPE_NUM] = {
+    "class", "list", "map", "module", "range", "string",
+    "upvalue", "function", "closure", "instance", "thread", "set"
+};
+
+void InitGCStats(GCStats *stats)
+{
+    memset(stats, 0, sizeof(GCStats));
+}
+
+/**
+ * @brief 单调时钟的当前时间，纳秒
+*/
+uint64_t GCStatsNowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+const char* GCStatsTypeName(ObjType type)
+{
+    return typeNames[type];
+}
+
+/**
+ * @brief 把一次停顿计入直方图
+*/
+static void RecordPause(GCStats *stats, uint64_t pauseNs)
+{
+    uint64_t us = pauseNs / 1000;
+    uint32_t bucket = 0;
+    while (us > 1 && bucket < GC_PAUSE_BUCKET_NUM - 1) {
+        us >>= 1;
+        bucket ++;
+    }
+    stats->pauseHistogram[bucket] ++;
+    stats->lastPauseNs = pauseNs;
+    if (pauseNs > stats->maxPauseNs) {
+        stats->maxPauseNs = pauseNs;
+    }
+}
+
+/**
+ * @brief 记录一次GC，各类型的存活统计已由清扫阶段填好
+*/
+void GCStatsRecordGC(GCStats *stats, uint64_t markNs, uint64_t sweepNs,
+                     uint64_t beforeBytes, uint64_t afterBytes)
+{
+    stats->gcNum ++;
+    stats->markNs += markNs;
+    stats->sweepNs += sweepNs;
+    stats->lastReclaimedBytes = beforeBytes > afterBytes ? beforeBytes - afterBytes : 0;
+    stats->reclaimedBytes += stats->lastReclaimedBytes;
+    RecordPause(stats, markNs + sweepNs);
+
+    if (stats->eventLog == NULL) {
+        return;
+    }
+    uint64_t liveNum = 0;
+    uint32_t idx = 0;
+    while (idx < GC_OBJ_TYPE_NUM) {
+        liveNum += stats->live[idx].objectNum;
+        idx ++;
+    }
+    fprintf(stats->eventLog,
+            "{\"event\":\"gc\",\"seq\":%lu,\"markNs\":%lu,\"sweepNs\":%lu,"
+            "\"before\":%lu,\"after\":%lu,\"reclaimed\":%lu,\"liveObjects\":%lu}\n",
+            (unsigned long)stats->gcNum, (unsigned long)markNs, (unsigned long)sweepNs,
+            (unsigned long)beforeBytes, (unsigned long)afterBytes,
+            (unsigned long)stats->lastReclaimedBytes, (unsigned long)liveNum);
+    fflush(stats->eventLog);
+}
+
+/**
+ * @brief 记录一次堆整理
+*/
+void GCStatsRecordCompact(GCStats *stats, uint64_t compactNs, uint32_t pageNum)
+{
+    stats->compactNum ++;
+    stats->compactNs += compactNs;
+    RecordPause(stats, compactNs);
+
+    if (stats->eventLog == NULL) {
+        return;
+    }
+    fprintf(stats->eventLog, "{\"event\":\"compact\",\"seq\":%lu,\"ns\":%lu,\"pages\":%u}\n",
+            (unsigned long)stats->compactNum, (unsigned long)compactNs, pageNum);
+    fflush(stats->eventLog);
+}
+
+/**
+ * @brief 以一行JSON输出全部统计
+*/
+void GCStatsWriteJson(GCStats *stats, FILE *out)
+{
+    fprintf(out, "{\"gcNum\":%lu,\"compactNum\":%lu,\"markNs\":%lu,\"sweepNs\":%lu,"
+            "\"compactNs\":%lu,\"lastPauseNs\":%lu,\"maxPauseNs\":%lu,\"reclaimedBytes\":%lu,",
+            (unsigned long)stats->gcNum, (unsigned long)stats->compactNum,
+            (unsigned long)stats->markNs, (unsigned long)stats->sweepNs,
+            (unsigned long)stats->compactNs, (unsigned long)stats->lastPauseNs,
+            (unsigned long)stats->maxPauseNs, (unsigned long)stats->reclaimedBytes);
+
+    fprintf(out, "\"pauseHistogram\":[");
+    uint32_t idx = 0;
+    while (idx < GC_PAUSE_BUCKET_NUM) {
+        fprintf(out, idx == 0 ? "%lu" : ",%lu", (unsigned long)stats->pauseHistogram[idx]);
+        idx ++;
+    }
+
+    fprintf(out, "],\"live\":{");
+    idx = 0;
+    while (idx < GC_OBJ_TYPE_NUM) {
+        fprintf(out, "%s\"%s\":{\"objects\":%lu,\"bytes\":%lu}", idx == 0 ? "" : ",",
+                typeNames[idx], (unsigned long)stats->live[idx].objectNum,
+                (unsigned long)stats->live[idx].bytes);
+        idx ++;
+    }
+    fprintf(out, "}}\n");
+}
@@ -0,0 +1,43 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-06 21:03:12
+ * @Description: GC统计，记录标记和清扫的次数与耗时、停顿时间分布、回收量以及各类型的存活对象
+ */
+#ifndef __GC_GC_STATS_H__
+#define __GC_GC_STATS_H__
+
+#include "header_obj.h"
+#include <stdio.h>
+
+#define GC_OBJ_TYPE_NUM (OT_SET + 1) // 对象类型的个数
+#define GC_PAUSE_BUCKET_NUM 16 // 停顿时间直方图的桶数，第i个桶统计[2^i, 2^(i+1))微秒的停顿，最后一个桶不设上限
+
+typedef struct {
+    uint64_t objectNum; // 存活对象个数
+    uint64_t bytes; // 存活对象自身占用的字节数
+} GCTypeStats; // 某一类型对象的存活统计
+
+typedef struct {
+    uint64_t gcNum; // GC次数
+    uint64_t compactNum; // 堆整理次数
+    uint64_t markNs; // 标记阶段累计耗时，纳秒
+    uint64_t sweepNs; // 清扫阶段累计耗时
+    uint64_t compactNs; // 堆整理累计耗时
+    uint64_t lastPauseNs; // 最近一次停顿的耗时
+    uint64_t maxPauseNs; // 最长的一次停顿
+    uint64_t pauseHistogram[GC_PAUSE_BUCKET_NUM]; // 停顿时间直方图
+    uint64_t reclaimedBytes; // 累计回收的字节数
+    uint64_t lastReclaimedBytes; // 最近一次GC回收的字节数
+    GCTypeStats live[GC_OBJ_TYPE_NUM]; // 最近一次GC后各类型的存活情况
+    FILE *eventLog; // 不为NULL时每次GC后向其写入一行JSON事件
+} GCStats; // GC统计
+
+void InitGCStats(GCStats *stats);
+uint64_t GCStatsNowNs(void);
+const char* GCStatsTypeName(ObjType type);
+void GCStatsRecordGC(GCStats *stats, uint64_t markNs, uint64_t sweepNs,
+                     uint64_t beforeBytes, uint64_t afterBytes);
+void GCStatsRecordCompact(GCStats *stats, uint64_t compactNs, uint32_t pageNum);
+void GCStatsWriteJson(GCStats *stats, FILE *out);
+
+#endif // !__GC_GC_STATS_H__
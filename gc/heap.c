@@ -0,0 +1,583 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-02 20:15:02
+ * @Description: 对象堆
+ */
+#include "heap.h"
+#include "vm.h"
+#include <string.h>
+
+// 页头之后才是slot区，页头按slot粒度对齐
+#define PAGE_HEADER_SIZE ((sizeof(HeapPage) + HEAP_SLOT_ALIGN - 1) & ~(HEAP_SLOT_ALIGN - 1))
+
+/**
+ * @brief 求size所属的尺寸类
+ *          [16, 256]以16递增，(256, 1024]以64递增，(1024, 4096]以256递增
+*/
+static uint32_t SizeToClass(size_t size)
+{
+    if (size <= 256) {
+        return (size + 15) / 16 - 1;
+    }
+    if (size <= 1024) {
+        return 16 + (size - 256 + 63) / 64 - 1;
+    }
+    return 28 + (size - 1024 + 255) / 256 - 1;
+}
+
+/**
+ * @brief 尺寸类对应的slot大小
+*/
+static uint32_t ClassToSize(uint32_t sizeClass)
+{
+    if (sizeClass < 16) {
+        return (sizeClass + 1) * 16;
+    }
+    if (sizeClass < 28) {
+        return 256 + (sizeClass - 15) * 64;
+    }
+    return 1024 + (sizeClass - 27) * 256;
+}
+
+/**
+ * @brief 将page插入链表list的头部
+*/
+static void LinkPage(HeapPage **list, HeapPage *page)
+{
+    page->prev = NULL;
+    page->next = *list;
+    if (*list != NULL) {
+        (*list)->prev = page;
+    }
+    *list = page;
+}
+
+/**
+ * @brief 将page从链表list中摘除
+*/
+static void UnlinkPage(HeapPage **list, HeapPage *page)
+{
+    if (page->prev != NULL) {
+        page->prev->next = page->next;
+    } else {
+        *list = page->next;
+    }
+    if (page->next != NULL) {
+        page->next->prev = page->prev;
+    }
+    page->prev = page->next = NULL;
+}
+
+/**
+ * @brief 新建一个堆页，pageSize为页的总字节数
+*/
+static HeapPage* NewPage(uint32_t sizeClass, uint32_t slotSize, uint32_t slotNum, size_t pageSize)
+{
+    void *mem = NULL;
+    if (posix_memalign(&mem, HEAP_PAGE_SIZE, pageSize) != 0) {
+        return NULL;
+    }
+    // 标记位图与分配位图放在同一块页外内存中
+    uint32_t words = (slotNum + 63) / 64;
+    uint64_t *bitmaps = (uint64_t *)calloc(words * 2, sizeof(uint64_t));
+    if (bitmaps == NULL) {
+        free(mem);
+        return NULL;
+    }
+
+    HeapPage *page = (HeapPage *)mem;
+    page->prev = page->next = NULL;
+    page->sizeClass = sizeClass;
+    page->slotSize = slotSize;
+    page->slotNum = slotNum;
+    page->usedNum = 0;
+    page->evacuating = false;
+    page->slots = (char *)mem + PAGE_HEADER_SIZE;
+    page->markBits = bitmaps;
+    page->allocBits = bitmaps + words;
+    return page;
+}
+
+/**
+ * @brief 释放堆页
+*/
+static void ReleasePage(HeapPage *page)
+{
+    free(page->markBits); // allocBits与markBits同属一块内存
+    free(page);
+}
+
+/**
+ * @brief 在page中找一个空闲slot并置为已分配，没有空闲slot则返回NULL
+*/
+static void* AllocateSlot(HeapPage *page)
+{
+    if (page->usedNum == page->slotNum) {
+        return NULL;
+    }
+    uint32_t words = (page->slotNum + 63) / 64;
+    uint32_t idx = 0;
+    while (idx < words) {
+        uint64_t freeBits = ~page->allocBits[idx];
+        if (freeBits != 0) {
+            uint32_t slotIdx = idx * 64 + __builtin_ctzll(freeBits);
+            if (slotIdx >= page->slotNum) {
+                break; // 最后一个字中超出slotNum的位不可用
+            }
+            page->allocBits[idx] |= 1ULL << (slotIdx & 63);
+            page->usedNum ++;
+            return page->slots + (size_t)slotIdx * page->slotSize;
+        }
+        idx ++;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 对象在所属页中的slot索引
+*/
+inline static uint32_t SlotIndex(HeapPage *page, void *obj)
+{
+    return (uint32_t)(((char *)obj - page->slots) / page->slotSize);
+}
+
+/**
+ * @brief 初始化堆
+*/
+void InitHeap(Heap *heap)
+{
+    uint32_t idx = 0;
+    while (idx < HEAP_SIZE_CLASS_NUM) {
+        heap->pages[idx] = NULL;
+        heap->allocPage[idx] = NULL;
+        heap->poolSlots[idx] = NULL;
+        heap->poolNum[idx] = 0;
+        idx ++;
+    }
+    heap->largePages = NULL;
+    heap->pageNum = 0;
+}
+
+/**
+ * @brief 释放堆中所有的页
+*/
+void FreeHeap(Heap *heap)
+{
+    uint32_t idx = 0;
+    while (idx < HEAP_SIZE_CLASS_NUM) {
+        while (heap->pages[idx] != NULL) {
+            HeapPage *page = heap->pages[idx];
+            UnlinkPage(&heap->pages[idx], page);
+            ReleasePage(page);
+        }
+        idx ++;
+    }
+    while (heap->largePages != NULL) {
+        HeapPage *page = heap->largePages;
+        UnlinkPage(&heap->largePages, page);
+        ReleasePage(page);
+    }
+    InitHeap(heap);
+}
+
+/**
+ * @brief 从堆中分配size字节的对象空间，失败返回NULL
+*/
+void* HeapAllocate(Heap *heap, size_t size)
+{
+    // 大对象独占一页
+    if (size > HEAP_MAX_SMALL_SIZE) {
+        HeapPage *page = NewPage(HEAP_LARGE_CLASS, (uint32_t)size, 1, PAGE_HEADER_SIZE + size);
+        if (page == NULL) {
+            return NULL;
+        }
+        LinkPage(&heap->largePages, page);
+        heap->pageNum ++;
+        return AllocateSlot(page);
+    }
+
+    uint32_t sizeClass = SizeToClass(size);
+    // 先从空闲slot池中取
+    void *pooled = heap->poolSlots[sizeClass];
+    if (pooled != NULL) {
+        heap->poolSlots[sizeClass] = *(void **)pooled;
+        heap->poolNum[sizeClass] --;
+        return pooled;
+    }
+
+    HeapPage *page = heap->allocPage[sizeClass];
+    void *slot = (page == NULL || page->evacuating) ? NULL: AllocateSlot(page);
+    if (slot != NULL) {
+        return slot;
+    }
+
+    // 最近使用的页已满，从本尺寸类的其他页中找空闲slot
+    page = heap->pages[sizeClass];
+    while (page != NULL) {
+        if (page->usedNum < page->slotNum && !page->evacuating) {
+            heap->allocPage[sizeClass] = page;
+            return AllocateSlot(page);
+        }
+        page = page->next;
+    }
+
+    // 都满了就新建一页
+    uint32_t slotSize = ClassToSize(sizeClass);
+    page = NewPage(sizeClass, slotSize, (HEAP_PAGE_SIZE - PAGE_HEADER_SIZE) / slotSize, HEAP_PAGE_SIZE);
+    if (page == NULL) {
+        return NULL;
+    }
+    LinkPage(&heap->pages[sizeClass], page);
+    heap->allocPage[sizeClass] = page;
+    heap->pageNum ++;
+    return AllocateSlot(page);
+}
+
+/**
+ * @brief 把slot真正归还给所在页，空页交还给系统
+*/
+static void ReleaseSlot(Heap *heap, HeapPage *page, void *obj)
+{
+    uint32_t slotIdx = SlotIndex(page, obj);
+    ASSERT((page->allocBits[slotIdx / 64] >> (slotIdx & 63)) & 1, "double free of heap slot!");
+    page->allocBits[slotIdx / 64] &= ~(1ULL << (slotIdx & 63));
+    page->usedNum --;
+
+    // 每个尺寸类至少保留一页，避免在边界上反复申请释放
+    uint32_t sizeClass = page->sizeClass;
+    if (page->usedNum == 0 && (page->prev != NULL || page->next != NULL)) {
+        if (heap->allocPage[sizeClass] == page) {
+            heap->allocPage[sizeClass] = NULL;
+        }
+        UnlinkPage(&heap->pages[sizeClass], page);
+        ReleasePage(page);
+        heap->pageNum --;
+    }
+}
+
+/**
+ * @brief 归还对象占用的slot，池未满时先放入空闲slot池
+*/
+void HeapFree(Heap *heap, void *obj)
+{
+    HeapPage *page = HEAP_PAGE_OF(obj);
+    if (page->sizeClass == HEAP_LARGE_CLASS) {
+        UnlinkPage(&heap->largePages, page);
+        ReleasePage(page);
+        heap->pageNum --;
+        return;
+    }
+
+    uint32_t sizeClass = page->sizeClass;
+    if (heap->poolNum[sizeClass] < HEAP_POOL_BYTES / page->slotSize) {
+        *(void **)obj = heap->poolSlots[sizeClass];
+        heap->poolSlots[sizeClass] = obj;
+        heap->poolNum[sizeClass] ++;
+        return;
+    }
+    ReleaseSlot(heap, page, obj);
+}
+
+/**
+ * @brief 清空所有空闲slot池，池中slot归还给所在页
+ *          搬迁对象前须先清空，否则池中可能留有被搬空页中的slot
+*/
+void HeapFlushPools(Heap *heap)
+{
+    uint32_t idx = 0;
+    while (idx < HEAP_SIZE_CLASS_NUM) {
+        void *slot = heap->poolSlots[idx];
+        heap->poolSlots[idx] = NULL;
+        heap->poolNum[idx] = 0;
+        while (slot != NULL) {
+            void *next = *(void **)slot;
+            ReleaseSlot(heap, HEAP_PAGE_OF(slot), slot);
+            slot = next;
+        }
+        idx ++;
+    }
+}
+
+/**
+ * @brief 标记对象，返回对象在此之前是否已被标记
+*/
+boolean HeapMark(void *obj)
+{
+    HeapPage *page = HEAP_PAGE_OF(obj);
+    uint32_t slotIdx = SlotIndex(page, obj);
+    uint64_t bit = 1ULL << (slotIdx & 63);
+    uint64_t *word = &page->markBits[slotIdx / 64];
+    if (*word & bit) {
+        return true;
+    }
+    *word |= bit;
+    return false;
+}
+
+/**
+ * @brief HeapMark的原子版本，供并行标记使用，多个线程同时标记同一对象时只有一个返回false
+*/
+boolean HeapMarkAtomic(void *obj)
+{
+    HeapPage *page = HEAP_PAGE_OF(obj);
+    uint32_t slotIdx = SlotIndex(page, obj);
+    uint64_t bit = 1ULL << (slotIdx & 63);
+    uint64_t *word = &page->markBits[slotIdx / 64];
+    // 先做一次普通读，已标记的对象不必发起原子写
+    if (__atomic_load_n(word, __ATOMIC_RELAXED) & bit) {
+        return true;
+    }
+    return (__atomic_fetch_or(word, bit, __ATOMIC_ACQ_REL) & bit) != 0;
+}
+
+/**
+ * @brief 对象是否已被标记
+*/
+boolean HeapIsMarked(void *obj)
+{
+    HeapPage *page = HEAP_PAGE_OF(obj);
+    uint32_t slotIdx = SlotIndex(page, obj);
+    return (page->markBits[slotIdx / 64] >> (slotIdx & 63)) & 1;
+}
+
+/**
+ * @brief 清除所有标记位，代价只与页数有关
+*/
+void HeapClearMarks(Heap *heap)
+{
+    uint32_t idx = 0;
+    while (idx < HEAP_SIZE_CLASS_NUM) {
+        HeapPage *page = heap->pages[idx];
+        while (page != NULL) {
+            memset(page->markBits, 0, (page->slotNum + 63) / 64 * sizeof(uint64_t));
+            page = page->next;
+        }
+        idx ++;
+    }
+    HeapPage *page = heap->largePages;
+    while (page != NULL) {
+        page->markBits[0] = 0;
+        page = page->next;
+    }
+}
+
+/**
+ * @brief 对page中bits标识的各slot调用visit，bits为从第wordIdx个字起的位图
+*/
+static void VisitSlots(HeapPage *page, uint32_t wordIdx, uint64_t bits, HeapVisitor visit, void *arg)
+{
+    while (bits != 0) {
+        uint32_t slotIdx = wordIdx * 64 + __builtin_ctzll(bits);
+        visit(page->slots + (size_t)slotIdx * page->slotSize, arg);
+        bits &= bits - 1;
+    }
+}
+
+/**
+ * @brief 遍历堆中所有已分配的对象，正在搬空的页中只剩转发地址，跳过
+ *          visit中不能分配或释放对象
+*/
+void HeapWalk(Heap *heap, HeapVisitor visit, void *arg)
+{
+    // 池中的slot在位图中记为已分配，但并不是对象
+    HeapFlushPools(heap);
+    uint32_t idx = 0;
+    while (idx < HEAP_SIZE_CLASS_NUM) {
+        HeapPage *page = heap->pages[idx];
+        while (page != NULL) {
+            if (!page->evacuating) {
+                uint32_t words = (page->slotNum + 63) / 64;
+                uint32_t wordIdx = 0;
+                while (wordIdx < words) {
+                    VisitSlots(page, wordIdx, page->allocBits[wordIdx], visit, arg);
+                    wordIdx ++;
+                }
+            }
+            page = page->next;
+        }
+        idx ++;
+    }
+    HeapPage *page = heap->largePages;
+    while (page != NULL) {
+        visit(page->slots, arg);
+        page = page->next;
+    }
+}
+
+/**
+ * @brief 清扫：已分配而未标记的对象先交给finalize释放其附属内存，再回收slot
+ *          整页都空的页交还给系统，留下来的页中回收的slot补充进空闲slot池
+*/
+void HeapSweep(Heap *heap, HeapVisitor finalize, void *arg)
+{
+    HeapFlushPools(heap);
+    uint64_t garbage[HEAP_BITMAP_WORDS];
+    uint32_t idx = 0;
+    while (idx < HEAP_SIZE_CLASS_NUM) {
+        HeapPage *page = heap->pages[idx];
+        while (page != NULL) {
+            HeapPage *next = page->next;
+            uint32_t words = (page->slotNum + 63) / 64;
+            uint32_t wordIdx = 0;
+            while (wordIdx < words) {
+                garbage[wordIdx] = page->allocBits[wordIdx] & ~page->markBits[wordIdx];
+                VisitSlots(page, wordIdx, garbage[wordIdx], finalize, arg);
+                page->allocBits[wordIdx] &= ~garbage[wordIdx];
+                page->usedNum -= __builtin_popcountll(garbage[wordIdx]);
+                wordIdx ++;
+            }
+
+            if (page->usedNum == 0 && (page->prev != NULL || page->next != NULL)) {
+                if (heap->allocPage[idx] == page) {
+                    heap->allocPage[idx] = NULL;
+                }
+                UnlinkPage(&heap->pages[idx], page);
+                ReleasePage(page);
+                heap->pageNum --;
+                page = next;
+                continue;
+            }
+
+            // 池中的slot仍记为已分配
+            uint32_t poolCapacity = HEAP_POOL_BYTES / page->slotSize;
+            wordIdx = 0;
+            while (wordIdx < words && heap->poolNum[idx] < poolCapacity) {
+                uint64_t bits = garbage[wordIdx];
+                while (bits != 0 && heap->poolNum[idx] < poolCapacity) {
+                    uint32_t slotIdx = wordIdx * 64 + __builtin_ctzll(bits);
+                    void *slot = page->slots + (size_t)slotIdx * page->slotSize;
+                    page->allocBits[wordIdx] |= 1ULL << (slotIdx & 63);
+                    page->usedNum ++;
+                    *(void **)slot = heap->poolSlots[idx];
+                    heap->poolSlots[idx] = slot;
+                    heap->poolNum[idx] ++;
+                    bits &= bits - 1;
+                }
+                wordIdx ++;
+            }
+            page = next;
+        }
+        idx ++;
+    }
+
+    HeapPage *page = heap->largePages;
+    while (page != NULL) {
+        HeapPage *next = page->next;
+        if ((page->markBits[0] & 1) == 0) {
+            finalize(page->slots, arg);
+            UnlinkPage(&heap->largePages, page);
+            ReleasePage(page);
+            heap->pageNum --;
+        }
+        page = next;
+    }
+}
+
+/**
+ * @brief 小对象页中未被使用的slot空间占比
+*/
+double HeapFragmentation(Heap *heap)
+{
+    uint64_t totalBytes = 0, usedBytes = 0;
+    uint32_t pageNum = 0;
+    uint32_t idx = 0;
+    while (idx < HEAP_SIZE_CLASS_NUM) {
+        HeapPage *page = heap->pages[idx];
+        while (page != NULL) {
+            totalBytes += (uint64_t)page->slotNum * page->slotSize;
+            usedBytes += (uint64_t)page->usedNum * page->slotSize;
+            pageNum ++;
+            page = page->next;
+        }
+        idx ++;
+    }
+    if (pageNum < HEAP_COMPACT_MIN_PAGES || totalBytes == 0) {
+        return 0.0;
+    }
+    return 1.0 - (double)usedBytes / (double)totalBytes;
+}
+
+/**
+ * @brief 挑选需要搬空的页，返回选中的页数
+ *          同一尺寸类中至少有两个稀疏页才搬迁，其中最满的那页保留下来承接搬出的对象
+*/
+uint32_t HeapSelectEvacuationPages(Heap *heap)
+{
+    HeapFlushPools(heap);
+    uint32_t selected = 0;
+    uint32_t idx = 0;
+    while (idx < HEAP_SIZE_CLASS_NUM) {
+        HeapPage *densest = NULL;
+        uint32_t sparseNum = 0;
+        HeapPage *page = heap->pages[idx];
+        while (page != NULL) {
+            if (page->usedNum < page->slotNum * HEAP_EVACUATE_OCCUPANCY) {
+                page->evacuating = true;
+                sparseNum ++;
+                if (densest == NULL || page->usedNum > densest->usedNum) {
+                    densest = page;
+                }
+            }
+            page = page->next;
+        }
+        if (sparseNum < 2) {
+            if (densest != NULL) {
+                densest->evacuating = false;
+            }
+        } else {
+            densest->evacuating = false;
+            selected += sparseNum - 1;
+        }
+        heap->allocPage[idx] = densest;
+        idx ++;
+    }
+    return selected;
+}
+
+/**
+ * @brief 释放已搬空的页，其中的对象都已复制到别处
+*/
+void HeapReleaseEvacuatedPages(Heap *heap)
+{
+    uint32_t idx = 0;
+    while (idx < HEAP_SIZE_CLASS_NUM) {
+        HeapPage *page = heap->pages[idx];
+        while (page != NULL) {
+            HeapPage *next = page->next;
+            if (page->evacuating) {
+                if (heap->allocPage[idx] == page) {
+                    heap->allocPage[idx] = NULL;
+                }
+                UnlinkPage(&heap->pages[idx], page);
+                ReleasePage(page);
+                heap->pageNum --;
+            }
+            page = next;
+        }
+        idx ++;
+    }
+}
+
+/**
+ * @brief 为对象分配内存
+*/
+void* AllocateObject(VM *vm, size_t size)
+{
+    vm->allocatedBytes += size;
+    if (vm->allocatedBytes > vm->config.nextGC) {
+        vm->gcPending = true;
+    }
+    void *obj = HeapAllocate(&vm->heap, size);
+    if (obj == NULL) {
+        MEM_ERROR("Allocate object of %lu bytes failed!", (unsigned long)size);
+    }
+    return obj;
+}
+
+/**
+ * @brief 释放对象自身占用的内存
+*/
+void FreeObjectMemory(VM *vm, void *obj)
+{
+    HeapFree(&vm->heap, obj);
+}
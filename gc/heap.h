@@ -0,0 +1,79 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-02 20:14:36
+ * @Description: 对象堆，对象按尺寸类分配在对齐的堆页中，标记位存放在页外的位图里
+ */
+#ifndef __GC_HEAP_H__
+#define __GC_HEAP_H__
+
+#include "common.h"
+
+#define HEAP_PAGE_SIZE (64 * 1024) // 堆页大小，页起始地址按此对齐
+#define HEAP_SLOT_ALIGN 16 // slot的最小粒度
+#define HEAP_MAX_SMALL_SIZE 4096 // 超过此大小的对象单独占用一个大对象页
+#define HEAP_SIZE_CLASS_NUM 40 // 尺寸类的个数
+#define HEAP_LARGE_CLASS HEAP_SIZE_CLASS_NUM // 大对象页的尺寸类标识
+#define HEAP_BITMAP_WORDS (HEAP_PAGE_SIZE / HEAP_SLOT_ALIGN / 64) // 每页位图所需的64位字数
+#define HEAP_COMPACT_MIN_PAGES 16 // 小对象页少于此数时不考虑整理
+#define HEAP_EVACUATE_OCCUPANCY 0.5 // 使用率低于此值的页是搬迁候选
+#define HEAP_POOL_BYTES HEAP_PAGE_SIZE // 每个尺寸类空闲slot池最多缓存的字节数
+#define MAX_MARK_THREADS 8 // 并行标记的最大线程数
+#define PARALLEL_MARK_MIN_PAGES 256 // 堆页少于此数时单线程标记，线程开销得不偿失
+
+typedef struct heapPage {
+    struct heapPage *prev;
+    struct heapPage *next; // 链接同一尺寸类的页
+    uint32_t sizeClass; // 所属尺寸类，大对象页为HEAP_LARGE_CLASS
+    uint32_t slotSize; // 每个slot的字节数
+    uint32_t slotNum; // 本页slot总数
+    uint32_t usedNum; // 已分配的slot数
+    boolean evacuating; // 本页对象正在被搬出，不再从本页分配
+    char *slots; // 第一个slot的地址
+    // 位图不放在页内，标记和清除标记都不会写对象所在的内存页，
+    // 这样fork出的子进程在GC后仍能与父进程共享这些页(写时复制)
+    uint64_t *markBits; // 标记位图，置1表示对象可达
+    uint64_t *allocBits; // 分配位图，置1表示slot已分配
+} HeapPage; // 堆页
+
+typedef struct {
+    HeapPage *pages[HEAP_SIZE_CLASS_NUM]; // 各尺寸类的页链表
+    HeapPage *allocPage[HEAP_SIZE_CLASS_NUM]; // 各尺寸类最近一次分配所用的页
+    HeapPage *largePages; // 大对象页链表
+    // 各尺寸类的空闲slot池，回收的slot先放进池中，分配时直接取出，不用扫描位图
+    // 池中slot在位图中仍记为已分配，首个字链接下一个空闲slot
+    void *poolSlots[HEAP_SIZE_CLASS_NUM];
+    uint32_t poolNum[HEAP_SIZE_CLASS_NUM]; // 池中slot数
+    uint32_t pageNum; // 堆页总数
+} Heap; // 对象堆
+
+typedef void (*HeapVisitor)(void *obj, void *arg); // 遍历堆中对象时的回调
+
+// 由对象地址找到其所在的堆页
+#define HEAP_PAGE_OF(objPtr) ((HeapPage *)((uintptr_t)(objPtr) & ~((uintptr_t)HEAP_PAGE_SIZE - 1)))
+
+// 对象分配，分配的内存计入vm->allocatedBytes
+#define ALLOCATE_OBJ(vmPtr, type) \
+    (type *)AllocateObject(vmPtr, sizeof(type))
+
+// 带柔性数组的对象分配
+#define ALLOCATE_OBJ_EXTRA(vmPtr, mainType, extraSize) \
+    (mainType *)AllocateObject(vmPtr, sizeof(mainType) + extraSize)
+
+void InitHeap(Heap *heap);
+void FreeHeap(Heap *heap);
+void* HeapAllocate(Heap *heap, size_t size);
+void HeapFree(Heap *heap, void *obj);
+void HeapFlushPools(Heap *heap);
+boolean HeapMark(void *obj);
+boolean HeapMarkAtomic(void *obj);
+boolean HeapIsMarked(void *obj);
+void HeapClearMarks(Heap *heap);
+void HeapWalk(Heap *heap, HeapVisitor visit, void *arg);
+void HeapSweep(Heap *heap, HeapVisitor finalize, void *arg);
+double HeapFragmentation(Heap *heap);
+uint32_t HeapSelectEvacuationPages(Heap *heap);
+void HeapReleaseEvacuatedPages(Heap *heap);
+void* AllocateObject(VM *vm, size_t size);
+void FreeObjectMemory(VM *vm, void *obj);
+
+#endif // !__GC_HEAP_H__
@@ -0,0 +1,197 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-08 20:41:37
+ * @Description: 大块内存空间
+ */
+#define _GNU_SOURCE // mremap
+#include "large_space.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define REGION_TABLE_MIN_CAPACITY 16
+
+/**
+ * @brief 把size向上取整到系统页大小
+*/
+static size_t RoundToOsPage(size_t size)
+{
+    size_t osPage = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + osPage - 1) & ~(osPage - 1);
+}
+
+/**
+ * @brief 映射区地址的哈希，映射区按系统页对齐，低12位无用
+*/
+inline static uint32_t HashAddress(void *base, uint32_t capacity)
+{
+    uint64_t h = (uint64_t)(uintptr_t)base >> 12;
+    h *= 0x9e3779b97f4a7c15ULL;
+    return (uint32_t)(h >> 32) & (capacity - 1);
+}
+
+/**
+ * @brief 查找base所在的哈希表位置，不存在时返回其应插入的空位
+*/
+static LargeRegion* FindRegion(LargeRegion *regions, uint32_t capacity, void *base)
+{
+    uint32_t idx = HashAddress(base, capacity);
+    while (regions[idx].base != NULL && regions[idx].base != base) {
+        idx = (idx + 1) & (capacity - 1);
+    }
+    return &regions[idx];
+}
+
+/**
+ * @brief 哈希表扩容到newCapacity并重新插入所有映射区
+*/
+static void ResizeRegionTable(LargeSpace *space, uint32_t newCapacity)
+{
+    LargeRegion *newRegions = (LargeRegion *)calloc(newCapacity, sizeof(LargeRegion));
+    if (newRegions == NULL) {
+        MEM_ERROR("Allocate large space table failed!");
+    }
+    uint32_t idx = 0;
+    while (idx < space->capacity) {
+        if (space->regions[idx].base != NULL) {
+            *FindRegion(newRegions, newCapacity, space->regions[idx].base) = space->regions[idx];
+        }
+        idx ++;
+    }
+    free(space->regions);
+    space->regions = newRegions;
+    space->capacity = newCapacity;
+}
+
+/**
+ * @brief 登记一块映射区
+*/
+static void AddRegion(LargeSpace *space, void *base, size_t size)
+{
+    // 装载因子保持在1/2以下
+    if ((space->count + 1) * 2 > space->capacity) {
+        ResizeRegionTable(space, space->capacity == 0 ? REGION_TABLE_MIN_CAPACITY : space->capacity * 2);
+    }
+    LargeRegion *region = FindRegion(space->regions, space->capacity, base);
+    region->base = base;
+    region->size = size;
+    space->count ++;
+    space->mappedBytes += size;
+}
+
+/**
+ * @brief 注销region，其后的同簇元素前移填补空位，不留墓碑
+*/
+static void RemoveRegion(LargeSpace *space, LargeRegion *region)
+{
+    uint32_t mask = space->capacity - 1;
+    uint32_t hole = (uint32_t)(region - space->regions);
+    space->mappedBytes -= region->size;
+    space->count --;
+
+    uint32_t idx = (hole + 1) & mask;
+    while (space->regions[idx].base != NULL) {
+        uint32_t home = HashAddress(space->regions[idx].base, space->capacity);
+        // home不在(hole, idx]区间内时，该元素可以移到hole
+        if (((idx - home) & mask) >= ((idx - hole) & mask)) {
+            space->regions[hole] = space->regions[idx];
+            hole = idx;
+        }
+        idx = (idx + 1) & mask;
+    }
+    space->regions[hole].base = NULL;
+    space->regions[hole].size = 0;
+}
+
+void InitLargeSpace(LargeSpace *space)
+{
+    space->regions = NULL;
+    space->capacity = 0;
+    space->count = 0;
+    space->mappedBytes = 0;
+}
+
+/**
+ * @brief 解除所有映射
+*/
+void FreeLargeSpace(LargeSpace *space)
+{
+    uint32_t idx = 0;
+    while (idx < space->capacity) {
+        if (space->regions[idx].base != NULL) {
+            munmap(space->regions[idx].base, space->regions[idx].size);
+        }
+        idx ++;
+    }
+    free(space->regions);
+    InitLargeSpace(space);
+}
+
+/**
+ * @brief ptr是否是本空间分配的内存
+*/
+boolean LargeSpaceOwns(LargeSpace *space, void *ptr)
+{
+    if (space->count == 0) {
+        return false;
+    }
+    return FindRegion(space->regions, space->capacity, ptr)->base != NULL;
+}
+
+/**
+ * @brief 映射一块至少size字节的内存，失败返回NULL
+*/
+void* LargeSpaceAllocate(LargeSpace *space, size_t size)
+{
+    size_t mapSize = RoundToOsPage(size);
+    void *base = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    AddRegion(space, base, mapSize);
+    return base;
+}
+
+/**
+ * @brief 把ptr所在的映射区调整为至少newSize字节，失败返回NULL且原映射区不变
+ *          能原地扩展时不复制，否则由内核移动页表，也不复制数据
+*/
+void* LargeSpaceReallocate(LargeSpace *space, void *ptr, size_t newSize)
+{
+    LargeRegion *region = FindRegion(space->regions, space->capacity, ptr);
+    ASSERT(region->base != NULL, "pointer isn't in large space!");
+    size_t mapSize = RoundToOsPage(newSize);
+    if (mapSize == region->size) {
+        return ptr;
+    }
+    size_t oldSize = region->size;
+#ifdef MREMAP_MAYMOVE
+    void *base = mremap(ptr, oldSize, mapSize, MREMAP_MAYMOVE);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+#else
+    void *base = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    memcpy(base, ptr, oldSize < mapSize ? oldSize : mapSize);
+    munmap(ptr, oldSize);
+#endif
+    RemoveRegion(space, region);
+    AddRegion(space, base, mapSize);
+    return base;
+}
+
+/**
+ * @brief 解除ptr所在映射区的映射，内存立即还给系统
+*/
+void LargeSpaceFree(LargeSpace *space, void *ptr)
+{
+    LargeRegion *region = FindRegion(space->regions, space->capacity, ptr);
+    ASSERT(region->base != NULL, "pointer isn't in large space!");
+    munmap(region->base, region->size);
+    RemoveRegion(space, region);
+}
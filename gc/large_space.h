@@ -0,0 +1,34 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-08 20:41:37
+ * @Description: 大块内存空间，超过阈值的缓冲区单独映射，可用mremap原地扩容，释放时直接还给系统
+ */
+#ifndef __GC_LARGE_SPACE_H__
+#define __GC_LARGE_SPACE_H__
+
+#include "common.h"
+#include <stddef.h>
+
+#define LARGE_SPACE_THRESHOLD (256 * 1024) // 达到此大小的缓冲区放入大块内存空间
+
+typedef struct {
+    void *base; // 映射区起始地址，为NULL表示空位
+    size_t size; // 映射区字节数，按系统页大小取整
+} LargeRegion; // 一块映射区
+
+typedef struct {
+    // DEALLOCATE不带原大小，只能凭地址判断内存是否属于本空间，因此以地址为键登记所有映射区
+    LargeRegion *regions; // 开放定址的哈希表
+    uint32_t capacity; // 哈希表容量，为2的幂
+    uint32_t count; // 映射区个数
+    size_t mappedBytes; // 映射的总字节数
+} LargeSpace; // 大块内存空间
+
+void InitLargeSpace(LargeSpace *space);
+void FreeLargeSpace(LargeSpace *space);
+boolean LargeSpaceOwns(LargeSpace *space, void *ptr);
+void* LargeSpaceAllocate(LargeSpace *space, size_t size);
+void* LargeSpaceReallocate(LargeSpace *space, void *ptr, size_t newSize);
+void LargeSpaceFree(LargeSpace *space, void *ptr);
+
+#endif // !__GC_LARGE_SPACE_H__
@@ -0,0 +1,85 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-10 21:12:45
+ * @Description: 内存竞技场
+ */
+#include "arena.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN_UP(size) (((size) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+#define CHUNK_HEADER_SIZE ALIGN_UP(sizeof(ArenaChunk))
+
+void InitArena(Arena *arena)
+{
+    arena->chunks = NULL;
+    arena->cur = arena->end = NULL;
+    arena->last = NULL;
+}
+
+/**
+ * @brief 一次性释放竞技场中的所有内存
+*/
+void FreeArena(Arena *arena)
+{
+    ArenaChunk *chunk = arena->chunks;
+    while (chunk != NULL) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    InitArena(arena);
+}
+
+/**
+ * @brief 从竞技场中分配size字节，内存不单独释放
+*/
+void* ArenaAlloc(Arena *arena, size_t size)
+{
+    size = ALIGN_UP(size == 0 ? 1 : size);
+    if (arena->cur == NULL || (size_t)(arena->end - arena->cur) < size) {
+        size_t chunkSize = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        ArenaChunk *chunk = (ArenaChunk *)malloc(CHUNK_HEADER_SIZE + chunkSize);
+        if (chunk == NULL) {
+            MEM_ERROR("Allocate arena chunk failed!");
+        }
+        chunk->size = chunkSize;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->cur = (char *)chunk + CHUNK_HEADER_SIZE;
+        arena->end = arena->cur + chunkSize;
+    }
+    void *ptr = arena->cur;
+    arena->cur += size;
+    arena->last = ptr;
+    return ptr;
+}
+
+/**
+ * @brief 把ptr扩大到newSize字节，ptr是最近一次分配且当前块放得下时原地扩展
+*/
+void* ArenaGrow(Arena *arena, void *ptr, size_t oldSize, size_t newSize)
+{
+    if (ptr != NULL && ptr == arena->last &&
+        (size_t)(arena->end - (char *)ptr) >= ALIGN_UP(newSize)) {
+        arena->cur = (char *)ptr + ALIGN_UP(newSize);
+        return ptr;
+    }
+    void *newPtr = ArenaAlloc(arena, newSize);
+    if (ptr != NULL) {
+        memcpy(newPtr, ptr, oldSize);
+    }
+    return newPtr;
+}
+
+/**
+ * @brief 在竞技场中复制长为length的字符串并补上'\0'
+*/
+char* ArenaStrndup(Arena *arena, const char *str, size_t length)
+{
+    char *copy = (char *)ArenaAlloc(arena, length + 1);
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
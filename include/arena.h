@@ -0,0 +1,45 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-10 21:12:45
+ * @Description: 内存竞技场，按块申请内存，顺序切分，最后整体释放
+ */
+#ifndef _INCLUDE_ARENA_H
+#define _INCLUDE_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_CHUNK_SIZE (16 * 1024) // 每次向系统申请的块大小，超过的请求单独成块
+#define ARENA_ALIGN 16
+
+typedef struct arenaChunk {
+    struct arenaChunk *next;
+    size_t size; // 可用字节数
+} ArenaChunk; // 竞技场中的一块内存，数据紧跟在块头之后
+
+typedef struct {
+    ArenaChunk *chunks; // 块链表，表头是当前正在切分的块
+    char *cur; // 当前块中下一次分配的位置
+    char *end; // 当前块的末尾
+    void *last; // 最近一次分配的地址，用于原地扩展
+} Arena;
+
+// 向竞技场中的buffer追加data，buffer为utils.h中DECLARE_BUFFER_TYPE定义的类型
+#define ARENA_BUFFER_ADD(arenaPtr, bufPtr, data) \
+    do { \
+        if ((bufPtr)->count >= (bufPtr)->capacity) { \
+            uint32_t newCapacity = (bufPtr)->capacity == 0 ? 8 : (bufPtr)->capacity * 2; \
+            (bufPtr)->datas = ArenaGrow(arenaPtr, (bufPtr)->datas, \
+                    (bufPtr)->capacity * sizeof((bufPtr)->datas[0]), newCapacity * sizeof((bufPtr)->datas[0])); \
+            (bufPtr)->capacity = newCapacity; \
+        } \
+        (bufPtr)->datas[(bufPtr)->count ++] = (data); \
+    } while (0)
+
+void InitArena(Arena *arena);
+void FreeArena(Arena *arena);
+void* ArenaAlloc(Arena *arena, size_t size);
+void* ArenaGrow(Arena *arena, void *ptr, size_t oldSize, size_t newSize);
+char* ArenaStrndup(Arena *arena, const char *str, size_t length);
+
+#endif // _INCLUDE_ARENA_H
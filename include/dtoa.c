@@ -0,0 +1,399 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-25 15:12:40
+ * @Description: 双精度数转最短字符串，Grisu2算法，结果能原样解析回同一个数
+ *               只用整数运算，不依赖c库的printf，各平台结果相同
+ */
+#include "dtoa.h"
+#include "common.h"
+#include <string.h>
+
+// 整数部分不超过此值时按整数直接输出
+#define DTOA_INT_LIMIT 1e15
+// 小数点位置在(DTOA_MIN_EXP, DTOA_MAX_EXP]之内时不用科学计数法，与%g的习惯一致
+#define DTOA_MIN_EXP -4
+#define DTOA_MAX_EXP 15
+
+// 指数-60~-32使乘上缓存的10的幂之后整数部分能放进32位
+#define GRISU_ALPHA -60
+#define GRISU_GAMMA -32
+
+#define CACHED_POWERS_MIN_DEC_EXP -300
+#define CACHED_POWERS_DEC_STEP 8
+
+typedef struct {
+    uint64_t f; // 有效数字
+    int e; // 二进制指数，值为f*2^e
+} DiyFp;
+
+typedef struct {
+    uint64_t f;
+    int e;
+    int k; // 十进制指数，f*2^e约等于10^k
+} CachedPower;
+
+// 10^-300到10^324每隔8取一个，有效数字规格化到64位并四舍五入
+static const CachedPower g_cachedPowers[] = {
+    { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+    { 0xBE5691EF416BD60CULL, -1007, -284 },
+    { 0x8DD01FAD907FFC3CULL,  -980, -276 },
+    { 0xD3515C2831559A83ULL,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+    { 0xEA9C227723EE8BCBULL,  -901, -252 },
+    { 0xAECC49914078536DULL,  -874, -244 },
+    { 0x823C12795DB6CE57ULL,  -847, -236 },
+    { 0xC21094364DFB5637ULL,  -821, -228 },
+    { 0x9096EA6F3848984FULL,  -794, -220 },
+    { 0xD77485CB25823AC7ULL,  -768, -212 },
+    { 0xA086CFCD97BF97F4ULL,  -741, -204 },
+    { 0xEF340A98172AACE5ULL,  -715, -196 },
+    { 0xB23867FB2A35B28EULL,  -688, -188 },
+    { 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+    { 0xC5DD44271AD3CDBAULL,  -635, -172 },
+    { 0x936B9FCEBB25C996ULL,  -608, -164 },
+    { 0xDBAC6C247D62A584ULL,  -582, -156 },
+    { 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+    { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+    { 0x87625F056C7C4A8BULL,  -475, -124 },
+    { 0xC9BCFF6034C13053ULL,  -449, -116 },
+    { 0x964E858C91BA2655ULL,  -422, -108 },
+    { 0xDFF9772470297EBDULL,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+    { 0xF8A95FCF88747D94ULL,  -343,  -84 },
+    { 0xB94470938FA89BCFULL,  -316,  -76 },
+    { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+    { 0xCDB02555653131B6ULL,  -263,  -60 },
+    { 0x993FE2C6D07B7FACULL,  -236,  -52 },
+    { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+    { 0xAA242499697392D3ULL,  -183,  -36 },
+    { 0xFD87B5F28300CA0EULL,  -157,  -28 },
+    { 0xBCE5086492111AEBULL,  -130,  -20 },
+    { 0x8CBCCC096F5088CCULL,  -103,  -12 },
+    { 0xD1B71758E219652CULL,   -77,   -4 },
+    { 0x9C40000000000000ULL,   -50,    4 },
+    { 0xE8D4A51000000000ULL,   -24,   12 },
+    { 0xAD78EBC5AC620000ULL,     3,   20 },
+    { 0x813F3978F8940984ULL,    30,   28 },
+    { 0xC097CE7BC90715B3ULL,    56,   36 },
+    { 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+    { 0xD5D238A4ABE98068ULL,   109,   52 },
+    { 0x9F4F2726179A2245ULL,   136,   60 },
+    { 0xED63A231D4C4FB27ULL,   162,   68 },
+    { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+    { 0x83C7088E1AAB65DBULL,   216,   84 },
+    { 0xC45D1DF942711D9AULL,   242,   92 },
+    { 0x924D692CA61BE758ULL,   269,  100 },
+    { 0xDA01EE641A708DEAULL,   295,  108 },
+    { 0xA26DA3999AEF774AULL,   322,  116 },
+    { 0xF209787BB47D6B85ULL,   348,  124 },
+    { 0xB454E4A179DD1877ULL,   375,  132 },
+    { 0x865B86925B9BC5C2ULL,   402,  140 },
+    { 0xC83553C5C8965D3DULL,   428,  148 },
+    { 0x952AB45CFA97A0B3ULL,   455,  156 },
+    { 0xDE469FBD99A05FE3ULL,   481,  164 },
+    { 0xA59BC234DB398C25ULL,   508,  172 },
+    { 0xF6C69A72A3989F5CULL,   534,  180 },
+    { 0xB7DCBF5354E9BECEULL,   561,  188 },
+    { 0x88FCF317F22241E2ULL,   588,  196 },
+    { 0xCC20CE9BD35C78A5ULL,   614,  204 },
+    { 0x98165AF37B2153DFULL,   641,  212 },
+    { 0xE2A0B5DC971F303AULL,   667,  220 },
+    { 0xA8D9D1535CE3B396ULL,   694,  228 },
+    { 0xFB9B7CD9A4A7443CULL,   720,  236 },
+    { 0xBB764C4CA7A44410ULL,   747,  244 },
+    { 0x8BAB8EEFB6409C1AULL,   774,  252 },
+    { 0xD01FEF10A657842CULL,   800,  260 },
+    { 0x9B10A4E5E9913129ULL,   827,  268 },
+    { 0xE7109BFBA19C0C9DULL,   853,  276 },
+    { 0xAC2820D9623BF429ULL,   880,  284 },
+    { 0x80444B5E7AA7CF85ULL,   907,  292 },
+    { 0xBF21E44003ACDD2DULL,   933,  300 },
+    { 0x8E679C2F5E44FF8FULL,   960,  308 },
+    { 0xD433179D9C8CB841ULL,   986,  316 },
+    { 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+};
+
+static DiyFp DiyFpSub(DiyFp x, DiyFp y)
+{
+    DiyFp r = {x.f - y.f, x.e};
+    return r;
+}
+
+/**
+ * @brief 两数相乘，保留128位积的高64位并按第63位四舍五入
+*/
+static DiyFp DiyFpMul(DiyFp x, DiyFp y)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t product = (__uint128_t)x.f * y.f;
+    uint64_t high = (uint64_t)(product >> 64) + (uint64_t)((product >> 63) & 1);
+#else
+    uint64_t xHigh = x.f >> 32, xLow = (uint32_t)x.f;
+    uint64_t yHigh = y.f >> 32, yLow = (uint32_t)y.f;
+    uint64_t hh = xHigh * yHigh, hl = xHigh * yLow, lh = xLow * yHigh, ll = xLow * yLow;
+    uint64_t mid = (ll >> 32) + (uint32_t)hl + (uint32_t)lh + (1ULL << 31);
+    uint64_t high = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+#endif
+    DiyFp r = {high, x.e + y.e + 64};
+    return r;
+}
+
+static DiyFp DiyFpNormalize(DiyFp x)
+{
+    int shift = __builtin_clzll(x.f);
+    DiyFp r = {x.f << shift, x.e - shift};
+    return r;
+}
+
+/**
+ * @brief 把x的指数调整为targetE，调用者保证有效数字不溢出
+*/
+static DiyFp DiyFpNormalizeTo(DiyFp x, int targetE)
+{
+    DiyFp r = {x.f << (x.e - targetE), targetE};
+    return r;
+}
+
+/**
+ * @brief 求num及其舍入区间的上下边界，区间内的数都会被解析为num
+ *          三者都规格化，且上下边界的指数与num相同
+*/
+static void ComputeBoundaries(double num, DiyFp *w, DiyFp *minus, DiyFp *plus)
+{
+    uint64_t bits;
+    memcpy(&bits, &num, sizeof(bits));
+    uint64_t fraction = bits & ((1ULL << 52) - 1);
+    int biasedExp = (int)(bits >> 52) & 0x7FF;
+
+    DiyFp v;
+    if (biasedExp == 0) { // 非规格化数
+        v.f = fraction;
+        v.e = 1 - 1075;
+    } else {
+        v.f = fraction | (1ULL << 52);
+        v.e = biasedExp - 1075;
+    }
+
+    // 有效数字为2的幂时下方相邻的数更近，下边界距离减半
+    boolean lowerCloser = fraction == 0 && biasedExp > 1;
+    DiyFp mPlus = {2 * v.f + 1, v.e - 1};
+    DiyFp mMinus;
+    if (lowerCloser) {
+        mMinus.f = 4 * v.f - 1;
+        mMinus.e = v.e - 2;
+    } else {
+        mMinus.f = 2 * v.f - 1;
+        mMinus.e = v.e - 1;
+    }
+
+    *plus = DiyFpNormalize(mPlus);
+    *minus = DiyFpNormalizeTo(mMinus, plus->e);
+    *w = DiyFpNormalize(v);
+}
+
+/**
+ * @brief 选取10^k，使其与2^e相乘后指数落在[GRISU_ALPHA, GRISU_GAMMA]
+*/
+static CachedPower GetCachedPower(int e)
+{
+    // k = ceil((GRISU_ALPHA - e - 1) * log10(2))，78913 / 2^18约为log10(2)
+    int f = GRISU_ALPHA - e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0);
+    int index = (-CACHED_POWERS_MIN_DEC_EXP + k + (CACHED_POWERS_DEC_STEP - 1)) / CACHED_POWERS_DEC_STEP;
+    return g_cachedPowers[index];
+}
+
+/**
+ * @brief 返回n的十进制位数，*pow10置为不大于n的最大的10的幂
+*/
+static int FindLargestPow10(uint32_t n, uint32_t *pow10)
+{
+    static const uint32_t powers[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+    };
+    int digits = 10;
+    while (digits > 1 && n < powers[digits - 1]) {
+        digits--;
+    }
+    *pow10 = powers[digits - 1];
+    return digits;
+}
+
+/**
+ * @brief 在不离开舍入区间的前提下把末位数字往w靠近
+*/
+static void Grisu2Round(char *buf, int length, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t tenK)
+{
+    while (rest < dist && delta - rest >= tenK &&
+        (rest + tenK < dist || dist - rest > rest + tenK - dist)) {
+        buf[length - 1]--;
+        rest += tenK;
+    }
+}
+
+/**
+ * @brief 逐位生成(minus, plus)区间内位数最少的数字串，结果为buf * 10^*decimalExp
+*/
+static int Grisu2DigitGen(char *buf, int *decimalExp, DiyFp minus, DiyFp w, DiyFp plus)
+{
+    uint64_t delta = DiyFpSub(plus, minus).f;
+    uint64_t dist = DiyFpSub(plus, w).f;
+
+    // one = 2^-e，plus按它拆成整数部分p1和小数部分p2
+    int shift = -plus.e;
+    uint64_t one = 1ULL << shift;
+    uint32_t p1 = (uint32_t)(plus.f >> shift);
+    uint64_t p2 = plus.f & (one - 1);
+
+    int length = 0;
+    uint32_t pow10;
+    int n = FindLargestPow10(p1, &pow10);
+    while (n > 0) {
+        buf[length++] = (char)('0' + p1 / pow10);
+        p1 %= pow10;
+        n--;
+        uint64_t rest = ((uint64_t)p1 << shift) + p2;
+        if (rest <= delta) {
+            *decimalExp += n;
+            Grisu2Round(buf, length, dist, delta, rest, (uint64_t)pow10 << shift);
+            return length;
+        }
+        pow10 /= 10;
+    }
+
+    // 整数部分不够区分，继续生成小数部分
+    int m = 0;
+    while (true) {
+        p2 *= 10;
+        buf[length++] = (char)('0' + (p2 >> shift));
+        p2 &= one - 1;
+        m++;
+        delta *= 10;
+        dist *= 10;
+        if (p2 <= delta) {
+            break;
+        }
+    }
+    *decimalExp -= m;
+    Grisu2Round(buf, length, dist, delta, p2, one);
+    return length;
+}
+
+/**
+ * @brief 生成正数num的最短数字串，返回位数，*decimalExp为十进制指数
+*/
+static int Grisu2(char *buf, int *decimalExp, double num)
+{
+    DiyFp w, minus, plus;
+    ComputeBoundaries(num, &w, &minus, &plus);
+
+    CachedPower cached = GetCachedPower(plus.e);
+    DiyFp c = {cached.f, cached.e};
+    w = DiyFpMul(w, c);
+    minus = DiyFpMul(minus, c);
+    plus = DiyFpMul(plus, c);
+
+    // 缓存的幂和乘法都有1单位的误差，区间两端各向内收1，保证结果仍在区间内
+    minus.f++;
+    plus.f--;
+
+    *decimalExp = -cached.k;
+    return Grisu2DigitGen(buf, decimalExp, minus, w, plus);
+}
+
+/**
+ * @brief 写十进制无符号整数，返回写入的字节数
+*/
+static int WriteUint(char *buf, uint64_t value)
+{
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    int idx = 0;
+    while (idx < count) {
+        buf[idx] = digits[count - 1 - idx];
+        idx++;
+    }
+    return count;
+}
+
+/**
+ * @brief 把数字串buf[0, length)按小数点位置排版，返回总长度
+ *          point为小数点位置，即值为0.buf * 10^point
+*/
+static int FormatDigits(char *buf, int length, int point)
+{
+    if (length <= point && point <= DTOA_MAX_EXP) {
+        // 整数:补零
+        memset(buf + length, '0', point - length);
+        return point;
+    }
+    if (0 < point && point <= DTOA_MAX_EXP) {
+        // 小数点在数字中间
+        memmove(buf + point + 1, buf + point, length - point);
+        buf[point] = '.';
+        return length + 1;
+    }
+    if (DTOA_MIN_EXP < point && point <= 0) {
+        // 0.00ddd
+        int zeros = -point;
+        memmove(buf + 2 + zeros, buf, length);
+        buf[0] = '0';
+        buf[1] = '.';
+        memset(buf + 2, '0', zeros);
+        return length + 2 + zeros;
+    }
+
+    // 科学计数法d.ddde+XX，指数至少两位，与%g相同
+    int pos = 1;
+    if (length > 1) {
+        memmove(buf + 2, buf + 1, length - 1);
+        buf[1] = '.';
+        pos = length + 1;
+    }
+    int exp = point - 1;
+    buf[pos++] = 'e';
+    if (exp < 0) {
+        buf[pos++] = '-';
+        exp = -exp;
+    } else {
+        buf[pos++] = '+';
+    }
+    if (exp < 10) {
+        buf[pos++] = '0';
+    }
+    pos += WriteUint(buf + pos, (uint64_t)exp);
+    return pos;
+}
+
+/**
+ * @brief 把有限的num写成能原样解析回来的最短十进制串，以\0结尾，返回长度
+ *          buf至少DTOA_BUFFER_SIZE字节，nan和无穷由调用者处理
+*/
+uint32_t FormatDouble(char *buf, double num)
+{
+    char *cur = buf;
+    // 负零也输出符号
+    if (num < 0 || (num == 0 && 1 / num < 0)) {
+        *cur++ = '-';
+        num = -num;
+    }
+
+    // 整数最常见，直接按整数输出，不必走Grisu
+    if (num < DTOA_INT_LIMIT && num == (double)(uint64_t)num) {
+        cur += WriteUint(cur, (uint64_t)num);
+        *cur = '\0';
+        return (uint32_t)(cur - buf);
+    }
+
+    int decimalExp;
+    int length = Grisu2(cur, &decimalExp, num);
+    cur += FormatDigits(cur, length, length + decimalExp);
+    *cur = '\0';
+    return (uint32_t)(cur - buf);
+}
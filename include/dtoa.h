@@ -0,0 +1,16 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-25 15:12:40
+ * @Description: 双精度数转最短字符串，Grisu2算法，结果能原样解析回同一个数
+ */
+#ifndef _INCLUDE_DTOA_H
+#define _INCLUDE_DTOA_H
+
+#include <stdint.h>
+
+// 最长的结果形如-1.2345678901234567e-308，留出余量
+#define DTOA_BUFFER_SIZE 32
+
+uint32_t FormatDouble(char *buf, double num);
+
+#endif
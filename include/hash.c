@@ -0,0 +1,120 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-22 21:06:33
+ * @Description: 带种子的哈希函数，按wyhash的思路每次处理8字节
+ */
+#include "hash.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// wyhash使用的常数
+static const uint64_t g_hashSecret[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+/**
+ * @brief 64位乘法，*a和*b分别置为128位乘积的低64位和高64位
+*/
+static inline void MulFold(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t product = (__uint128_t)*a * *b;
+    *a = (uint64_t)product;
+    *b = (uint64_t)(product >> 64);
+#else
+    // 没有128位整数时拆成32位相乘
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t carry = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    carry += lo < t;
+    uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+    *a = lo;
+    *b = hi;
+#endif
+}
+
+/**
+ * @brief 把a和b相乘后高低64位异或，是混合两个64位值的基本操作
+*/
+uint64_t HashMix(uint64_t a, uint64_t b)
+{
+    MulFold(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t Read8(const uint8_t *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t Read4(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief 以seed为种子哈希key开始的length个字节
+ *          16字节以内只读首尾两段，更长的每次取48字节分三路混合，不逐字节循环
+*/
+uint64_t HashBytes(const void *key, size_t length, uint64_t seed)
+{
+    const uint8_t *p = (const uint8_t *)key;
+    seed ^= HashMix(seed ^ g_hashSecret[0], g_hashSecret[1]);
+    uint64_t a, b;
+    if (length <= 16) {
+        if (length >= 4) {
+            // 首尾各取两个可能重叠的4字节
+            a = (Read4(p) << 32) | Read4(p + ((length >> 3) << 2));
+            b = (Read4(p + length - 4) << 32) | Read4(p + length - 4 - ((length >> 3) << 2));
+        } else if (length > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t remain = length;
+        if (remain > 48) {
+            uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = HashMix(Read8(p) ^ g_hashSecret[1], Read8(p + 8) ^ seed);
+                seed1 = HashMix(Read8(p + 16) ^ g_hashSecret[2], Read8(p + 24) ^ seed1);
+                seed2 = HashMix(Read8(p + 32) ^ g_hashSecret[3], Read8(p + 40) ^ seed2);
+                p += 48;
+                remain -= 48;
+            } while (remain > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (remain > 16) {
+            seed = HashMix(Read8(p) ^ g_hashSecret[1], Read8(p + 8) ^ seed);
+            p += 16;
+            remain -= 16;
+        }
+        // 最后16字节，可能与已处理的部分重叠
+        a = Read8(p + remain - 16);
+        b = Read8(p + remain - 8);
+    }
+    a ^= g_hashSecret[1];
+    b ^= seed;
+    MulFold(&a, &b);
+    return HashMix(a ^ g_hashSecret[0] ^ length, b ^ g_hashSecret[1]);
+}
+
+/**
+ * @brief 生成哈希种子，外部输入无法预知，用以抵御构造冲突key的哈希洪水攻击
+ *          salt一般传入虚拟机地址，同一进程中的多个虚拟机也各不相同
+*/
+uint64_t NewHashSeed(const void *salt)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t seed = HashMix((uint64_t)now.tv_sec ^ g_hashSecret[2], (uint64_t)now.tv_nsec ^ g_hashSecret[3]);
+    return HashMix(seed ^ (uint64_t)(uintptr_t)salt, (uint64_t)getpid() ^ g_hashSecret[0]);
+}
@@ -0,0 +1,16 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-22 21:06:33
+ * @Description: 带种子的哈希函数，按wyhash的思路每次处理8字节
+ */
+#ifndef _INCLUDE_HASH_H
+#define _INCLUDE_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t HashBytes(const void *key, size_t length, uint64_t seed);
+uint64_t HashMix(uint64_t a, uint64_t b);
+uint64_t NewHashSeed(const void *salt);
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-26 10:27:15
+ * @Description: 十进制串转双精度数，Eisel-Lemire算法，词法分析和Num.fromString共用
+ */
+#ifndef _INCLUDE_NUM_PARSE_H
+#define _INCLUDE_NUM_PARSE_H
+
+#include "common.h"
+
+uint32_t ParseDouble(const char *str, uint32_t length, double *num, boolean *overflow);
+double ParseInteger(const char *str, uint32_t length, uint32_t base);
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-18 20:41:07
+ * @Description: 子串查找，短模式串用SIMD按首尾字节过滤，长模式串用two-way算法
+ */
+#include "str_search.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define STR_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+typedef int (*ShortSearchFn)(const uint8_t *haystack, uint32_t haystackLen,
+    const uint8_t *needle, uint32_t needleLen);
+
+/**
+ * @brief 从from处起逐字节查找needle，先用memchr找首字节，再比较尾字节和整串
+ *          也用于SIMD版本处理末尾不足一个向量的部分
+*/
+static int SearchShortFrom(const uint8_t *haystack, uint32_t haystackLen,
+    const uint8_t *needle, uint32_t needleLen, uint32_t from)
+{
+    uint8_t lastByte = needle[needleLen - 1];
+    // 窗口起点不超过range
+    uint32_t range = haystackLen - needleLen;
+    while (from <= range) {
+        const uint8_t *found = memchr(haystack + from, needle[0], range - from + 1);
+        if (found == NULL) {
+            return -1;
+        }
+        uint32_t idx = (uint32_t)(found - haystack);
+        if (haystack[idx + needleLen - 1] == lastByte &&
+            memcmp(haystack + idx, needle, needleLen) == 0) {
+            return (int)idx;
+        }
+        from = idx + 1;
+    }
+    return -1;
+}
+
+static int SearchShortScalar(const uint8_t *haystack, uint32_t haystackLen,
+    const uint8_t *needle, uint32_t needleLen)
+{
+    return SearchShortFrom(haystack, haystackLen, needle, needleLen, 0);
+}
+
+#ifdef STR_SEARCH_X86
+/**
+ * @brief 每次取16个窗口，窗口首字节与needle首字节、尾字节与needle尾字节同时相等的才是候选
+ *          候选很少，整体比较的开销可忽略
+*/
+__attribute__((target("sse2")))
+static int SearchShortSse2(const uint8_t *haystack, uint32_t haystackLen,
+    const uint8_t *needle, uint32_t needleLen)
+{
+    __m128i firstBytes = _mm_set1_epi8((char)needle[0]);
+    __m128i lastBytes = _mm_set1_epi8((char)needle[needleLen - 1]);
+    uint32_t idx = 0;
+    // 尾字节所在的16字节也要在haystack之内
+    while (idx + needleLen - 1 + 16 <= haystackLen) {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i *)(haystack + idx));
+        __m128i blockLast = _mm_loadu_si128((const __m128i *)(haystack + idx + needleLen - 1));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(firstBytes, blockFirst), _mm_cmpeq_epi8(lastBytes, blockLast)));
+        while (mask != 0) {
+            uint32_t offset = (uint32_t)__builtin_ctz(mask);
+            if (memcmp(haystack + idx + offset, needle, needleLen) == 0) {
+                return (int)(idx + offset);
+            }
+            mask &= mask - 1;
+        }
+        idx += 16;
+    }
+    return SearchShortFrom(haystack, haystackLen, needle, needleLen, idx);
+}
+
+/**
+ * @brief 同SearchShortSse2，每次取32个窗口
+*/
+__attribute__((target("avx2")))
+static int SearchShortAvx2(const uint8_t *haystack, uint32_t haystackLen,
+    const uint8_t *needle, uint32_t needleLen)
+{
+    __m256i firstBytes = _mm256_set1_epi8((char)needle[0]);
+    __m256i lastBytes = _mm256_set1_epi8((char)needle[needleLen - 1]);
+    uint32_t idx = 0;
+    while (idx + needleLen - 1 + 32 <= haystackLen) {
+        __m256i blockFirst = _mm256_loadu_si256((const __m256i *)(haystack + idx));
+        __m256i blockLast = _mm256_loadu_si256((const __m256i *)(haystack + idx + needleLen - 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(firstBytes, blockFirst), _mm256_cmpeq_epi8(lastBytes, blockLast)));
+        while (mask != 0) {
+            uint32_t offset = (uint32_t)__builtin_ctz(mask);
+            if (memcmp(haystack + idx + offset, needle, needleLen) == 0) {
+                return (int)(idx + offset);
+            }
+            mask &= mask - 1;
+        }
+        idx += 32;
+    }
+    return SearchShortFrom(haystack, haystackLen, needle, needleLen, idx);
+}
+#endif
+
+/**
+ * @brief 按运行时的cpu特性选择短模式串的查找函数
+*/
+static ShortSearchFn SelectShortSearch(void)
+{
+#ifdef STR_SEARCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SearchShortAvx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SearchShortSse2;
+    }
+#endif
+    return SearchShortScalar;
+}
+
+// 首次查找时选定，之后不变，多次赋值的结果相同
+static ShortSearchFn g_shortSearch = NULL;
+
+/**
+ * @brief 求needle的最大后缀，reverse为true时按反序比较字节
+ *          返回最大后缀起点的前一个下标(可能为-1)，周期写入periodPtr
+*/
+static int MaximalSuffix(const uint8_t *needle, uint32_t needleLen, int reverse, uint32_t *periodPtr)
+{
+    int suffix = -1;
+    uint32_t idx = 0, offset = 1, period = 1;
+    while (idx + offset < needleLen) {
+        uint8_t a = needle[suffix + offset];
+        uint8_t b = needle[idx + offset];
+        if (a == b) {
+            if (offset == period) {
+                idx += period;
+                offset = 1;
+            } else {
+                offset++;
+            }
+        } else if (reverse ? a < b : a > b) {
+            idx += offset;
+            offset = 1;
+            period = idx - suffix;
+        } else {
+            suffix = (int)idx;
+            idx++;
+            offset = period = 1;
+        }
+    }
+    *periodPtr = period;
+    return suffix;
+}
+
+/**
+ * @brief Crochemore-Perrin two-way算法，最坏情况线性时间，只用常数额外空间(外加256项的跳转表)
+ *          needle被临界分解为左右两半，先从左往右比较右半，再从右往左比较左半
+*/
+static int SearchTwoWay(const uint8_t *haystack, uint32_t haystackLen,
+    const uint8_t *needle, uint32_t needleLen)
+{
+    // 窗口末字节不在needle中时整个窗口跳过，在则对齐到needle中最后一次出现处
+    uint32_t shift[256];
+    uint8_t present[256];
+    memset(present, 0, sizeof(present));
+    uint32_t idx = 0;
+    while (idx < needleLen) {
+        present[needle[idx]] = 1;
+        shift[needle[idx]] = idx + 1;
+        idx++;
+    }
+
+    // 临界分解点取两种字节序下最大后缀中靠后的那个
+    uint32_t period, reversePeriod;
+    int split = MaximalSuffix(needle, needleLen, 0, &period);
+    int reverseSplit = MaximalSuffix(needle, needleLen, 1, &reversePeriod);
+    if (reverseSplit > split) {
+        split = reverseSplit;
+        period = reversePeriod;
+    }
+    uint32_t leftLen = (uint32_t)(split + 1);
+
+    // needle以period为周期时,匹配失败后已比较过的前缀可以记住不再比较
+    uint32_t memory0;
+    if (memcmp(needle, needle + period, leftLen) != 0) {
+        memory0 = 0;
+        // 非周期时左右两半中较长者加1即是安全的滑动距离
+        uint32_t rightLen = needleLen - leftLen;
+        period = (leftLen - 1 > rightLen ? leftLen - 1 : rightLen) + 1;
+    } else {
+        memory0 = needleLen - period;
+    }
+
+    uint32_t pos = 0, memory = 0, k;
+    while (haystackLen - pos >= needleLen) {
+        const uint8_t *window = haystack + pos;
+        uint8_t tail = window[needleLen - 1];
+        if (!present[tail]) {
+            pos += needleLen;
+            memory = 0;
+            continue;
+        }
+        k = needleLen - shift[tail];
+        if (k != 0) {
+            pos += k < memory ? memory : k;
+            memory = 0;
+            continue;
+        }
+
+        // 比较右半
+        k = leftLen > memory ? leftLen : memory;
+        while (k < needleLen && needle[k] == window[k]) {
+            k++;
+        }
+        if (k < needleLen) {
+            pos += k - split;
+            memory = 0;
+            continue;
+        }
+        // 比较左半
+        k = leftLen;
+        while (k > memory && needle[k - 1] == window[k - 1]) {
+            k--;
+        }
+        if (k <= memory) {
+            return (int)pos;
+        }
+        pos += period;
+        memory = memory0;
+    }
+    return -1;
+}
+
+/**
+ * @brief 在haystack中查找needle首次出现的下标，未找到返回-1，needle为空返回0
+*/
+int SearchBytes(const char *haystack, uint32_t haystackLen, const char *needle, uint32_t needleLen)
+{
+    if (needleLen == 0) {
+        return 0;
+    }
+    if (needleLen > haystackLen) {
+        return -1;
+    }
+    if (needleLen >= STR_SEARCH_TWO_WAY_MIN) {
+        return SearchTwoWay((const uint8_t *)haystack, haystackLen, (const uint8_t *)needle, needleLen);
+    }
+    if (g_shortSearch == NULL) {
+        g_shortSearch = SelectShortSearch();
+    }
+    return g_shortSearch((const uint8_t *)haystack, haystackLen, (const uint8_t *)needle, needleLen);
+}
@@ -0,0 +1,17 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-18 20:41:07
+ * @Description: 子串查找，短模式串用SIMD按首尾字节过滤，长模式串用two-way算法
+ */
+#ifndef _INCLUDE_STR_SEARCH_H
+#define _INCLUDE_STR_SEARCH_H
+
+#include <stdint.h>
+
+// 模式串不短于此长度时用two-way算法，保证最坏情况下也是线性时间
+// 更短的模式串按首尾字节过滤候选位置，候选再整体比较
+#define STR_SEARCH_TWO_WAY_MIN 32
+
+int SearchBytes(const char *haystack, uint32_t haystackLen, const char *needle, uint32_t needleLen);
+
+#endif
@@ -1,5 +1,10 @@
 #include "unicode.h"
 #include "common.h"
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /**
  * @brief 返回value按照UTF-8编码后的字节数
@@ -109,4 +114,111 @@ int DecodeUtf8(const uint8_t *bytePtr, uint32_t length)
         value = value << 6 | (*bytePtr & 0x3f);
     }
     return value;
-}
\ No newline at end of file
+}
+
+#define ASCII_HIGH_BITS 0x8080808080808080ULL // 8个字节的最高位
+
+/**
+ * @brief 返回buf开头连续ASCII字节的个数
+ *          用SSE2每次检查16个字节的最高位，没有SSE2时每次检查8个字节
+*/
+uint32_t AsciiPrefixLength(const uint8_t *buf, uint32_t length)
+{
+    uint32_t idx = 0;
+#ifdef __SSE2__
+    while (idx + 16 <= length) {
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(buf + idx)));
+        if (mask != 0) {
+            return idx + (uint32_t)__builtin_ctz(mask);
+        }
+        idx += 16;
+    }
+#endif
+    while (idx + 8 <= length) {
+        uint64_t word;
+        memcpy(&word, buf + idx, sizeof(word));
+        if ((word & ASCII_HIGH_BITS) != 0) {
+            break;
+        }
+        idx += 8;
+    }
+    while (idx < length && buf[idx] <= 0x7f) {
+        idx ++;
+    }
+    return idx;
+}
+
+/**
+ * @brief buf中是否全是ASCII字符
+*/
+boolean IsAsciiBuffer(const uint8_t *buf, uint32_t length)
+{
+    return AsciiPrefixLength(buf, length) == length;
+}
+
+/**
+ * @brief 校验buf是否是合法的UTF-8，不允许超长编码、代理区码点和超过0x10ffff的码点
+ *          成段的ASCII整段跳过，只有非ASCII字符才逐个解码
+*/
+boolean ValidateUtf8(const uint8_t *buf, uint32_t length)
+{
+    // 按字节数索引的最小码点，小于它的是超长编码
+    static const int minValue[5] = {0, 0, 0x80, 0x800, 0x10000};
+    uint32_t idx = 0;
+    while (true) {
+        idx += AsciiPrefixLength(buf + idx, length - idx);
+        if (idx >= length) {
+            return true;
+        }
+        uint32_t byteNum = GetByteNumOfDecodeUtf8(buf[idx]);
+        // 后续字节不能打头，0xf8及以上不是合法的首字节
+        if (byteNum <= 1 || buf[idx] >= 0xf8) {
+            return false;
+        }
+        int value = DecodeUtf8(buf + idx, length - idx);
+        if (value == -1 || value < minValue[byteNum] || value > 0x10ffff ||
+            (value >= 0xd800 && value <= 0xdfff)) {
+            return false;
+        }
+        idx += byteNum;
+    }
+}
+
+/**
+ * @brief 正向截取buf中从startIndex起count个字节覆盖的字符时，求出结果在buf中对应的连续字节段
+ *          即起始字节及其后首个字符起，到末字节所在字符结束为止
+ *          遇到非法的UTF-8序列返回false，由调用者逐个字符解码
+*/
+boolean FindUtf8Span(const uint8_t *buf, uint32_t length, uint32_t startIndex, uint32_t count,
+    uint32_t *spanStart, uint32_t *spanEnd)
+{
+    uint32_t idx = startIndex;
+    *spanStart = *spanEnd = startIndex;
+    boolean first = true;
+    while (idx < startIndex + count) {
+        uint32_t byteNum = GetByteNumOfDecodeUtf8(buf[idx]);
+        if (byteNum == 0) {
+            // 首字符之前的后续字节属于起点之前的字符，解码时也被丢弃
+            // 之后的后续字节不属于任何字符，解码时被丢弃而切片会保留，交给调用者解码
+            if (!first) {
+                return false;
+            }
+            idx ++;
+            continue;
+        }
+        if (DecodeUtf8(buf + idx, length - idx) == -1) {
+            return false;
+        }
+        if (first) {
+            *spanStart = idx;
+            first = false;
+        }
+        *spanEnd = idx + byteNum;
+        // 越过本字符的后续字节
+        idx += byteNum;
+    }
+    if (first) {
+        *spanEnd = *spanStart;
+    }
+    return true;
+}
@@ -7,10 +7,16 @@
 #define _INCLUDE_UNICODE_UTF_H
 
 #include <stdint.h>
+#include "common.h"
 
 uint32_t GetByteNumOfEncodeUtf8(int value);
 uint32_t GetByteNumOfDecodeUtf8(uint8_t byte);
 uint8_t EncodeUtf8(uint8_t *buf, int value);
 int DecodeUtf8(const uint8_t *bytePtr, uint32_t length);
+uint32_t AsciiPrefixLength(const uint8_t *buf, uint32_t length);
+boolean IsAsciiBuffer(const uint8_t *buf, uint32_t length);
+boolean ValidateUtf8(const uint8_t *buf, uint32_t length);
+boolean FindUtf8Span(const uint8_t *buf, uint32_t length, uint32_t startIndex, uint32_t count,
+    uint32_t *spanStart, uint32_t *spanEnd);
 
 #endif // _INCLUDE_UNICODE_UTF_H
\ No newline at end of file
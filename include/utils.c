@@ -10,19 +10,58 @@
 #include "color_print.h"
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief 调整大块内存空间中ptr的大小，缩到阈值一半以下时迁回普通内存
+*/
+static void* ReallocateLarge(VM *vm, void *ptr, uint32_t oldSize, uint32_t newSize)
+{
+    if (newSize >= LARGE_SPACE_THRESHOLD / 2) {
+        return LargeSpaceReallocate(&vm->largeSpace, ptr, newSize);
+    }
+    void *newPtr = malloc(newSize);
+    if (newPtr != NULL) {
+        memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+        LargeSpaceFree(&vm->largeSpace, ptr);
+    }
+    return newPtr;
+}
 
 void* MemManager(VM *vm, void *ptr, uint32_t oldSize, uint32_t newSize)
 {
-    vm->allocatedBytes += newSize - oldSize;
+    // 先加后减，64位累加不会因newSize小于oldSize而回绕
+    vm->allocatedBytes = vm->allocatedBytes + newSize - oldSize;
     if (newSize == 0) {
-        free(ptr);
+        if (ptr != NULL && LargeSpaceOwns(&vm->largeSpace, ptr)) {
+            LargeSpaceFree(&vm->largeSpace, ptr);
+        } else {
+            free(ptr);
+        }
         return NULL;
     }
 
-    // if (newSize > 0 && vm->allocatedBytes > vm->config.nextGC) {
-    //     StartGC(vm);
-    // }
-    return realloc(ptr, newSize);
+    // 此处调用方可能还持有未入根的对象，不能直接GC，只请求在下一个安全点GC
+    if (newSize > oldSize && vm->allocatedBytes > vm->config.nextGC) {
+        vm->gcPending = true;
+    }
+    void *newPtr = NULL;
+    if (ptr != NULL && LargeSpaceOwns(&vm->largeSpace, ptr)) {
+        newPtr = ReallocateLarge(vm, ptr, oldSize, newSize);
+    } else if (newSize >= LARGE_SPACE_THRESHOLD) {
+        // 从普通内存迁入大块内存空间，此后扩容不再复制
+        newPtr = LargeSpaceAllocate(&vm->largeSpace, newSize);
+        if (newPtr != NULL && ptr != NULL) {
+            memcpy(newPtr, ptr, oldSize);
+            free(ptr);
+        }
+    } else {
+        newPtr = realloc(ptr, newSize);
+    }
+    if (newPtr == NULL) {
+        MEM_ERROR("Allocate %u bytes failed!", newSize);
+    }
+    return newPtr;
 }
 
 /**
@@ -2,6 +2,7 @@
 #define _INCLUDE_UTILS_H
 
 #include "common.h"
+#include <string.h>
 
 #define DEFAULT_BUFFER_SIZE 512
 
@@ -43,6 +44,7 @@ typedef struct {
     void type##BufferInit(type##Buffer *buf); \
     void type##BufferFillWrite(VM *vm, type##Buffer *buf, type data, uint32_t fillCount); \
     void type##BufferAdd(VM *vm, type##Buffer *buf, type data); \
+    void type##BufferAppend(VM *vm, type##Buffer *buf, const type *datas, uint32_t count); \
     void type##BufferClear(VM *vm, type##Buffer *buf);
 
 // 定义buffer方法
@@ -54,7 +56,7 @@ typedef struct {
     } \
     void type##BufferFillWrite(VM *vm, type##Buffer *buf, type data, uint32_t fillCount) \
     { \
-        uint32_t newCounts = buf->capacity + fillCount; \
+        uint32_t newCounts = buf->count + fillCount; \
         if (newCounts > buf->capacity) { \
             size_t oldSize = buf->capacity * sizeof(type); \
             buf->capacity = CeilToPowerOf2(newCounts); \
@@ -72,6 +74,18 @@ typedef struct {
     { \
         type##BufferFillWrite(vm, buf, data, 1); \
     } \
+    void type##BufferAppend(VM *vm, type##Buffer *buf, const type *datas, uint32_t count) \
+    { \
+        uint32_t newCounts = buf->count + count; \
+        if (newCounts > buf->capacity) { \
+            size_t oldSize = buf->capacity * sizeof(type); \
+            buf->capacity = CeilToPowerOf2(newCounts); \
+            size_t newSize = buf->capacity * sizeof(type); \
+            buf->datas = (type *)MemManager(vm, buf->datas, oldSize, newSize); \
+        } \
+        memcpy(buf->datas + buf->count, datas, sizeof(type) * count); \
+        buf->count = newCounts; \
+    } \
     void type##BufferClear(VM *vm, type##Buffer *buf) \
     { \
         size_t oldSize = buf->capacity * sizeof(buf->datas[0]); \
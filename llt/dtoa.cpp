@@ -0,0 +1,58 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-25 16:03:12
+ * @Description: 双精度数转最短字符串
+ */
+#include "gtest/gtest.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+extern "C" {
+#include "dtoa.h"
+}
+
+static std::string Format(double num)
+{
+    char buf[DTOA_BUFFER_SIZE];
+    uint32_t length = FormatDouble(buf, num);
+    EXPECT_EQ(length, strlen(buf));
+    return std::string(buf, length);
+}
+
+TEST(Dtoa, FormatShortest)
+{
+    EXPECT_EQ(Format(0), "0");
+    EXPECT_EQ(Format(-0.0), "-0");
+    EXPECT_EQ(Format(0.1), "0.1");
+    EXPECT_EQ(Format(0.1 + 0.2), "0.30000000000000004");
+    EXPECT_EQ(Format(123456), "123456");
+    EXPECT_EQ(Format(1e15), "1e+15");
+    EXPECT_EQ(Format(0.00001), "1e-05");
+    EXPECT_EQ(Format(5e-324), "5e-324");
+    EXPECT_EQ(Format(1.7976931348623157e308), "1.7976931348623157e+308");
+}
+
+/**
+ * @brief 随机的双精度数格式化后用strtod解析回同一个数
+*/
+TEST(Dtoa, ShortestRoundTrip)
+{
+    uint64_t state = 88172645463325252ULL;
+    uint32_t idx = 0;
+    while (idx < 100000) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        double num;
+        memcpy(&num, &state, sizeof(num));
+        idx++;
+        if (isnan(num) || isinf(num)) {
+            continue;
+        }
+        std::string text = Format(num);
+        ASSERT_EQ(strtod(text.c_str(), NULL), num) << text;
+    }
+}
@@ -0,0 +1,231 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-04 19:36:21
+ * @Description: 回收和堆整理后存活对象与驻留表仍指向有效的对象
+ */
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// 头文件中用class作成员名，在C++中是关键字，包含时换个名字
+#define class klass
+extern "C" {
+#include "vm.h"
+#include "gc.h"
+#include "class.h"
+#include "obj_list.h"
+#include "obj_fn.h"
+#include "obj_string.h"
+}
+#undef class
+
+#define PARENT_LENGTH 100
+#define SLICE_OFFSET 10
+#define SLICE_LENGTH 50
+
+class GCTest: public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            vm = (VM *)malloc(sizeof(VM));
+            InitVM(vm);
+            // 挂在allModules下的list是根，其中的对象都可达
+            MapSet(vm, vm->allModules, NUM_TO_VALUE(0), OBJ_TO_VALUE(NewObjList(vm, 0)));
+        }
+
+        void TearDown() override
+        {
+            FreeVM(vm);
+        }
+
+        // 整理会搬迁对象，每次都从根重新取
+        ObjList *Roots()
+        {
+            return VALUE_TO_OBJLIST(MapGet(vm, vm->allModules, NUM_TO_VALUE(0)));
+        }
+
+        void Keep(ObjHeader *obj)
+        {
+            ValueBufferAdd(vm, &Roots()->elements, OBJ_TO_VALUE(obj));
+        }
+
+        ObjHeader *Kept(uint32_t idx)
+        {
+            return Roots()->elements.datas[idx].objHeader;
+        }
+
+        static std::string Text(uint32_t idx, uint32_t length)
+        {
+            char buf[16];
+            snprintf(buf, sizeof(buf), "%08u", idx);
+            std::string text(buf);
+            while (text.size() < length) {
+                text += (char)('a' + text.size() % 26);
+            }
+            return text;
+        }
+
+        static std::string Content(ObjString *objString)
+        {
+            return std::string(STRING_START(objString), objString->value.length);
+        }
+
+        // 驻留表中的字符串都能读出，且哈希值与内容相符
+        void ExpectStringTableValid()
+        {
+            uint32_t live = 0;
+            uint32_t idx = 0;
+            while (idx < vm->strings.capacity) {
+                ObjString *objString = vm->strings.strings[idx];
+                if (STRING_TABLE_ENTRY_IS_LIVE(objString)) {
+                    EXPECT_FALSE(HEAP_PAGE_OF(objString)->evacuating);
+                    EXPECT_EQ(objString->hashCode,
+                        HashString(vm->hashSeed, STRING_START(objString), objString->value.length));
+                    live++;
+                }
+                idx++;
+            }
+            EXPECT_EQ(live, vm->strings.count);
+        }
+
+        VM *vm;
+};
+
+/**
+ * @brief 回收后可达对象原样保留，不可达的驻留字符串从驻留表中剔除
+*/
+TEST_F(GCTest, CollectKeepsReachable)
+{
+    uint32_t idx = 0;
+    while (idx < 20000) {
+        std::string text = Text(idx, 40);
+        ObjString *objString = InternString(vm, text.c_str(), text.size());
+        if (idx % 10 == 0) {
+            Keep(&objString->objHeader);
+        }
+        idx++;
+    }
+    StartGC(vm);
+    EXPECT_EQ(vm->strings.count, 2000u);
+    ExpectStringTableValid();
+    idx = 0;
+    while (idx < 2000) {
+        std::string text = Text(idx * 10, 40);
+        EXPECT_EQ(Content((ObjString *)Kept(idx)), text);
+        EXPECT_EQ(&InternString(vm, text.c_str(), text.size())->objHeader, Kept(idx));
+        idx++;
+    }
+}
+
+/**
+ * @brief 整理把稀疏页中的存活对象搬走，搬迁后引用、驻留表、
+ *          已关闭upvalue指向自身的指针以及切片指向父串的指针都随之更新
+*/
+TEST_F(GCTest, CompactForwardsReferences)
+{
+    uint32_t idx = 0;
+    while (idx < 40000) {
+        std::string text = Text(idx, 40);
+        ObjString *interned = InternString(vm, text.c_str(), text.size());
+        std::string parentText = Text(idx, PARENT_LENGTH);
+        ObjString *parent = NewObjString(vm, parentText.c_str(), PARENT_LENGTH);
+        ObjUpvalue *upvalue = NewObjUpvalue(vm, NULL);
+        if (idx % 64 == 0) {
+            ObjString *slice = NewStringSlice(vm, parent, SLICE_OFFSET, SLICE_LENGTH);
+            ASSERT_TRUE(STRING_IS_SLICE(slice));
+            upvalue->closedUpvalue = NUM_TO_VALUE((double)idx);
+            upvalue->localVarPtr = &upvalue->closedUpvalue;
+            Keep(&interned->objHeader);
+            Keep(&slice->objHeader);
+            Keep(&upvalue->objHeader);
+        }
+        idx++;
+    }
+    uint32_t pageNum = vm->heap.pageNum;
+    ObjHeader *firstKept = Kept(0);
+
+    CompactHeap(vm);
+    EXPECT_EQ(vm->gcStats.compactNum, 1u);
+    EXPECT_LT(vm->heap.pageNum, pageNum / 4);
+    EXPECT_NE(Kept(0), firstKept);
+    ExpectStringTableValid();
+
+    uint32_t keptNum = Roots()->elements.count / 3;
+    ASSERT_EQ(keptNum, (40000u + 63) / 64);
+    idx = 0;
+    while (idx < keptNum) {
+        uint32_t seq = idx * 64;
+        std::string text = Text(seq, 40);
+        ObjString *interned = (ObjString *)Kept(idx * 3);
+        EXPECT_EQ(Content(interned), text);
+        EXPECT_EQ(InternString(vm, text.c_str(), text.size()), interned);
+
+        ObjString *slice = (ObjString *)Kept(idx * 3 + 1);
+        ASSERT_TRUE(STRING_IS_SLICE(slice));
+        ObjString *parent = STRING_AS_SLICE(slice)->parent;
+        EXPECT_FALSE(HEAP_PAGE_OF(parent)->evacuating);
+        EXPECT_EQ(STRING_START(slice), parent->value.start + SLICE_OFFSET);
+        EXPECT_EQ(Content(slice), Text(seq, PARENT_LENGTH).substr(SLICE_OFFSET, SLICE_LENGTH));
+
+        ObjUpvalue *upvalue = (ObjUpvalue *)Kept(idx * 3 + 2);
+        EXPECT_EQ(upvalue->localVarPtr, &upvalue->closedUpvalue);
+        EXPECT_EQ(upvalue->localVarPtr->num, seq);
+        idx++;
+    }
+
+    // 整理后还能正常分配和回收
+    StartGC(vm);
+    EXPECT_EQ(Content((ObjString *)Kept(0)), Text(0, 40));
+}
+
+/**
+ * @brief 堆足够大时多线程并行标记，结果与单线程标记一致：
+ *          存活对象完好，再单线程回收一次没有可回收的内存，各类型存活统计相同
+*/
+TEST_F(GCTest, ParallelMarkMatchesSerial)
+{
+    vm->config.markThreads = 4;
+    // 存活对象分散挂在多个子list下，标记任务能分给各个线程
+    uint32_t idx = 0;
+    while (idx < 64) {
+        Keep(&NewObjList(vm, 0)->objHeader);
+        idx++;
+    }
+    idx = 0;
+    while (idx < 300000) {
+        std::string text = Text(idx, 40);
+        ObjString *objString = NewObjString(vm, text.c_str(), text.size());
+        if (idx % 3 == 0) {
+            ObjList *bucket = (ObjList *)Kept(idx / 3 % 64);
+            ValueBufferAdd(vm, &bucket->elements, OBJ_TO_VALUE(objString));
+        }
+        idx++;
+    }
+    ASSERT_GE(vm->heap.pageNum, (uint32_t)PARALLEL_MARK_MIN_PAGES);
+
+    StartGC(vm);
+    EXPECT_GT(vm->gcStats.lastReclaimedBytes, 0u);
+    idx = 0;
+    while (idx < 100000) {
+        ObjList *bucket = (ObjList *)Kept(idx % 64);
+        ObjString *objString = (ObjString *)bucket->elements.datas[idx / 64].objHeader;
+        EXPECT_EQ(Content(objString), Text(idx * 3, 40));
+        idx++;
+    }
+    GCTypeStats parallelLive[GC_OBJ_TYPE_NUM];
+    memcpy(parallelLive, vm->gcStats.live, sizeof(parallelLive));
+    EXPECT_GE(parallelLive[OT_STRING].objectNum, 100000u);
+
+    vm->config.markThreads = 1;
+    StartGC(vm);
+    EXPECT_EQ(vm->gcStats.lastReclaimedBytes, 0u);
+    idx = 0;
+    while (idx < GC_OBJ_TYPE_NUM) {
+        EXPECT_EQ(vm->gcStats.live[idx].objectNum, parallelLive[idx].objectNum);
+        EXPECT_EQ(vm->gcStats.live[idx].bytes, parallelLive[idx].bytes);
+        idx++;
+    }
+}
@@ -0,0 +1,226 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-03 10:12:55
+ * @Description: 对象堆的分配、页外标记位图、清扫和空闲slot池
+ */
+#include "gtest/gtest.h"
+
+#include <string.h>
+#include <set>
+#include <vector>
+
+// 头文件中用class作成员名，在C++中是关键字，包含时换个名字
+#define class klass
+extern "C" {
+#include "heap.h"
+}
+#undef class
+
+class HeapTest: public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            InitHeap(&heap);
+        }
+
+        void TearDown() override
+        {
+            FreeHeap(&heap);
+        }
+
+        // 分配num个size字节的对象，各自的首个字记下序号
+        std::vector<void *> Allocate(uint32_t num, size_t size)
+        {
+            std::vector<void *> objs;
+            uint32_t idx = 0;
+            while (idx < num) {
+                void *obj = HeapAllocate(&heap, size);
+                memset(obj, 0, size);
+                *(uint32_t *)obj = idx;
+                objs.push_back(obj);
+                idx++;
+            }
+            return objs;
+        }
+
+        static void Count(void *obj, void *arg)
+        {
+            (void)obj;
+            (*(uint32_t *)arg)++;
+        }
+
+        Heap heap;
+};
+
+/**
+ * @brief 对象按slot粒度对齐，由地址能找到所在页，大对象单独占一页
+*/
+TEST_F(HeapTest, AllocateLayout)
+{
+    std::vector<void *> objs = Allocate(5000, 40);
+    uint32_t idx = 0;
+    while (idx < objs.size()) {
+        void *obj = objs[idx];
+        EXPECT_EQ((uintptr_t)obj % HEAP_SLOT_ALIGN, 0u);
+        HeapPage *page = HEAP_PAGE_OF(obj);
+        EXPECT_EQ((uintptr_t)page % HEAP_PAGE_SIZE, 0u);
+        EXPECT_GE(page->slotSize, 40u);
+        EXPECT_TRUE((char *)obj >= page->slots && (char *)obj < page->slots + page->slotNum * page->slotSize);
+        EXPECT_EQ(*(uint32_t *)obj, idx);
+        idx++;
+    }
+    EXPECT_GT(heap.pageNum, 1u);
+
+    void *large = HeapAllocate(&heap, HEAP_MAX_SMALL_SIZE + 1);
+    EXPECT_EQ(HEAP_PAGE_OF(large)->sizeClass, (uint32_t)HEAP_LARGE_CLASS);
+    EXPECT_EQ(heap.largePages, HEAP_PAGE_OF(large));
+}
+
+/**
+ * @brief 标记位在页外的位图中，标记和清除标记都不写对象本身
+*/
+TEST_F(HeapTest, MarkBitsOutsideObjects)
+{
+    std::vector<void *> objs = Allocate(3000, 64);
+    std::vector<char> before(64);
+    memcpy(before.data(), objs[100], 64);
+
+    uint32_t idx = 0;
+    while (idx < objs.size()) {
+        EXPECT_FALSE(HeapIsMarked(objs[idx]));
+        EXPECT_FALSE(HeapMark(objs[idx]));
+        idx++;
+    }
+    EXPECT_TRUE(HeapMark(objs[0]));
+    EXPECT_TRUE(HeapIsMarked(objs[2999]));
+    EXPECT_EQ(memcmp(before.data(), objs[100], 64), 0);
+
+    HeapClearMarks(&heap);
+    EXPECT_FALSE(HeapIsMarked(objs[0]));
+    EXPECT_FALSE(HeapIsMarked(objs[2999]));
+    EXPECT_EQ(memcmp(before.data(), objs[100], 64), 0);
+}
+
+/**
+ * @brief 清扫只回收未标记的对象，整页为空的页交还给系统
+*/
+TEST_F(HeapTest, SweepUnmarked)
+{
+    std::vector<void *> objs = Allocate(20000, 48);
+    void *large = HeapAllocate(&heap, 10000);
+    uint32_t pageNum = heap.pageNum;
+    uint32_t idx = 0;
+    while (idx < objs.size()) {
+        if (idx % 2 == 0) {
+            HeapMark(objs[idx]);
+        }
+        idx++;
+    }
+
+    uint32_t freed = 0;
+    HeapSweep(&heap, Count, &freed);
+    EXPECT_EQ(freed, 10001u);
+    EXPECT_EQ(heap.largePages, nullptr);
+    EXPECT_EQ(heap.pageNum, pageNum - 1);
+    (void)large;
+
+    // 留下的对象原样保留
+    uint32_t live = 0;
+    HeapWalk(&heap, Count, &live);
+    EXPECT_EQ(live, 10000u);
+    idx = 0;
+    while (idx < objs.size()) {
+        EXPECT_EQ(*(uint32_t *)objs[idx], idx);
+        idx += 2;
+    }
+
+    // 全部不可达后每个尺寸类只保留一页
+    HeapClearMarks(&heap);
+    freed = 0;
+    HeapSweep(&heap, Count, &freed);
+    EXPECT_EQ(freed, 10000u);
+    EXPECT_EQ(heap.pageNum, 1u);
+    live = 0;
+    HeapWalk(&heap, Count, &live);
+    EXPECT_EQ(live, 0u);
+}
+
+/**
+ * @brief 释放的slot先进池，同尺寸的下次分配直接取出，池满后才归还给页
+*/
+TEST_F(HeapTest, PoolReusesFreedSlots)
+{
+    std::vector<void *> objs = Allocate(4000, 32);
+    uint32_t sizeClass = HEAP_PAGE_OF(objs[0])->sizeClass;
+    uint32_t poolCapacity = HEAP_POOL_BYTES / HEAP_PAGE_OF(objs[0])->slotSize;
+
+    HeapFree(&heap, objs[10]);
+    HeapFree(&heap, objs[20]);
+    EXPECT_EQ(heap.poolNum[sizeClass], 2u);
+    // 后进先出
+    EXPECT_EQ(HeapAllocate(&heap, 32), objs[20]);
+    EXPECT_EQ(HeapAllocate(&heap, 25), objs[10]);
+    EXPECT_EQ(heap.poolNum[sizeClass], 0u);
+
+    // 池满后多出的slot回到页中
+    uint32_t idx = 0;
+    while (idx < objs.size()) {
+        HeapFree(&heap, objs[idx]);
+        idx++;
+    }
+    EXPECT_EQ(heap.poolNum[sizeClass], poolCapacity);
+    // 池中的slot仍记为已分配，清空池后整页为空的页被释放
+    EXPECT_GT(heap.pageNum, 1u);
+    HeapFlushPools(&heap);
+    EXPECT_EQ(heap.poolNum[sizeClass], 0u);
+    EXPECT_EQ(heap.poolSlots[sizeClass], nullptr);
+    EXPECT_EQ(heap.pageNum, 1u);
+    EXPECT_EQ(heap.pages[sizeClass]->usedNum, 0u);
+}
+
+/**
+ * @brief 清扫回收的slot补充进池，不同尺寸类的池互不干扰
+*/
+TEST_F(HeapTest, SweepRefillsPool)
+{
+    std::vector<void *> small = Allocate(1000, 16);
+    std::vector<void *> big = Allocate(100, 1000);
+    uint32_t smallClass = HEAP_PAGE_OF(small[0])->sizeClass;
+    uint32_t bigClass = HEAP_PAGE_OF(big[0])->sizeClass;
+    uint32_t idx = 0;
+    while (idx < small.size()) {
+        if (idx % 4 != 0) {
+            HeapMark(small[idx]);
+        }
+        idx++;
+    }
+    idx = 0;
+    while (idx < big.size()) {
+        HeapMark(big[idx]);
+        idx++;
+    }
+
+    uint32_t freed = 0;
+    HeapSweep(&heap, Count, &freed);
+    EXPECT_EQ(freed, 250u);
+    EXPECT_EQ(heap.poolNum[smallClass], 250u);
+    EXPECT_EQ(heap.poolNum[bigClass], 0u);
+    HeapClearMarks(&heap);
+
+    // 池中取出的都是刚回收的slot，池用slot的首个字串成链表，序号已被覆盖，按地址比对
+    std::set<void *> garbage;
+    idx = 0;
+    while (idx < small.size()) {
+        garbage.insert(small[idx]);
+        idx += 4;
+    }
+    idx = 0;
+    while (idx < 250) {
+        EXPECT_EQ(garbage.erase(HeapAllocate(&heap, 16)), 1u);
+        idx++;
+    }
+    EXPECT_EQ(heap.poolNum[smallClass], 0u);
+    uint32_t live = 0;
+    HeapWalk(&heap, Count, &live);
+    EXPECT_EQ(live, 1100u);
+}
@@ -0,0 +1,195 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-08 21:15:42
+ * @Description: 大块内存空间的映射、mremap扩容和释放
+ */
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// 头文件中用class作成员名，在C++中是关键字，包含时换个名字
+#define class klass
+extern "C" {
+#include "vm.h"
+#include "gc.h"
+#include "large_space.h"
+#include "utils.h"
+#include "class.h"
+#include "obj_list.h"
+}
+#undef class
+
+#define MB (1024 * 1024)
+
+static void Fill(uint8_t *buf, size_t size)
+{
+    size_t idx = 0;
+    while (idx < size) {
+        buf[idx] = (uint8_t)(idx * 7 + idx / 4096);
+        idx++;
+    }
+}
+
+static boolean CheckFill(const uint8_t *buf, size_t size)
+{
+    size_t idx = 0;
+    while (idx < size) {
+        if (buf[idx] != (uint8_t)(idx * 7 + idx / 4096)) {
+            return false;
+        }
+        idx++;
+    }
+    return true;
+}
+
+class LargeSpaceTest: public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            InitLargeSpace(&space);
+        }
+
+        void TearDown() override
+        {
+            FreeLargeSpace(&space);
+        }
+
+        LargeSpace space;
+};
+
+/**
+ * @brief 扩容后内容不变，登记的映射区随之更新，释放后映射区全部归还
+*/
+TEST_F(LargeSpaceTest, ReallocatePreservesContent)
+{
+    uint8_t *buf = (uint8_t *)LargeSpaceAllocate(&space, 1 * MB);
+    ASSERT_NE(buf, nullptr);
+    EXPECT_TRUE(LargeSpaceOwns(&space, buf));
+    EXPECT_EQ(space.count, 1u);
+    EXPECT_EQ(space.mappedBytes, (size_t)1 * MB);
+    Fill(buf, 1 * MB);
+
+    uint8_t *grown = (uint8_t *)LargeSpaceReallocate(&space, buf, 8 * MB);
+    ASSERT_NE(grown, nullptr);
+    EXPECT_TRUE(LargeSpaceOwns(&space, grown));
+    if (grown != buf) {
+        EXPECT_FALSE(LargeSpaceOwns(&space, buf));
+    }
+    EXPECT_EQ(space.count, 1u);
+    EXPECT_EQ(space.mappedBytes, (size_t)8 * MB);
+    EXPECT_TRUE(CheckFill(grown, 1 * MB));
+    // 新增部分可写
+    memset(grown + 1 * MB, 0x5a, 7 * MB);
+
+    LargeSpaceFree(&space, grown);
+    EXPECT_FALSE(LargeSpaceOwns(&space, grown));
+    EXPECT_EQ(space.count, 0u);
+    EXPECT_EQ(space.mappedBytes, 0u);
+}
+
+/**
+ * @brief 登记表扩容并交错释放后，其余映射区仍能凭地址找到，非本空间的地址不属于本空间
+*/
+TEST_F(LargeSpaceTest, OwnsAcrossRemoval)
+{
+    std::vector<void *> bufs;
+    uint32_t idx = 0;
+    while (idx < 100) {
+        void *buf = LargeSpaceAllocate(&space, LARGE_SPACE_THRESHOLD);
+        ASSERT_NE(buf, nullptr);
+        bufs.push_back(buf);
+        idx++;
+    }
+    EXPECT_EQ(space.count, 100u);
+    idx = 0;
+    while (idx < 100) {
+        if (idx % 3 != 0) {
+            LargeSpaceFree(&space, bufs[idx]);
+        }
+        idx++;
+    }
+    EXPECT_EQ(space.count, 34u);
+    idx = 0;
+    while (idx < 100) {
+        EXPECT_EQ(LargeSpaceOwns(&space, bufs[idx]), idx % 3 == 0);
+        idx++;
+    }
+    void *other = malloc(64);
+    EXPECT_FALSE(LargeSpaceOwns(&space, other));
+    free(other);
+}
+
+class LargeSpaceVMTest: public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            vm = (VM *)malloc(sizeof(VM));
+            InitVM(vm);
+        }
+
+        void TearDown() override
+        {
+            FreeVM(vm);
+        }
+
+        VM *vm;
+};
+
+/**
+ * @brief 缓冲区达到阈值时迁入大块内存空间，缩到阈值一半以下时迁回普通内存，内容都不变
+*/
+TEST_F(LargeSpaceVMTest, MigrateByThreshold)
+{
+    uint8_t *buf = (uint8_t *)MemManager(vm, NULL, 0, 1024);
+    Fill(buf, 1024);
+    EXPECT_FALSE(LargeSpaceOwns(&vm->largeSpace, buf));
+
+    buf = (uint8_t *)MemManager(vm, buf, 1024, 1 * MB);
+    EXPECT_TRUE(LargeSpaceOwns(&vm->largeSpace, buf));
+    EXPECT_TRUE(CheckFill(buf, 1024));
+    Fill(buf, 1 * MB);
+
+    // 阈值与其一半之间仍留在大块内存空间，避免在阈值附近来回迁移
+    buf = (uint8_t *)MemManager(vm, buf, 1 * MB, LARGE_SPACE_THRESHOLD / 2);
+    EXPECT_TRUE(LargeSpaceOwns(&vm->largeSpace, buf));
+    EXPECT_TRUE(CheckFill(buf, LARGE_SPACE_THRESHOLD / 2));
+
+    buf = (uint8_t *)MemManager(vm, buf, LARGE_SPACE_THRESHOLD / 2, 4096);
+    EXPECT_FALSE(LargeSpaceOwns(&vm->largeSpace, buf));
+    EXPECT_EQ(vm->largeSpace.count, 0u);
+    EXPECT_TRUE(CheckFill(buf, 4096));
+    MemManager(vm, buf, 4096, 0);
+}
+
+/**
+ * @brief list不断增长后元素缓冲区落在大块内存空间，内容完好，list被回收后映射区归还
+*/
+TEST_F(LargeSpaceVMTest, ListGrowsIntoLargeSpace)
+{
+    ObjList *list = NewObjList(vm, 0);
+    // 挂在allModules下作为根
+    MapSet(vm, vm->allModules, NUM_TO_VALUE(0), OBJ_TO_VALUE(list));
+    uint32_t idx = 0;
+    while (idx < 200000) {
+        ValueBufferAdd(vm, &list->elements, NUM_TO_VALUE((double)idx));
+        idx++;
+    }
+    EXPECT_TRUE(LargeSpaceOwns(&vm->largeSpace, list->elements.datas));
+    EXPECT_EQ(vm->largeSpace.count, 1u);
+
+    StartGC(vm);
+    list = VALUE_TO_OBJLIST(MapGet(vm, vm->allModules, NUM_TO_VALUE(0)));
+    ASSERT_EQ(list->elements.count, 200000u);
+    idx = 0;
+    while (idx < 200000) {
+        EXPECT_EQ(list->elements.datas[idx].num, (double)idx);
+        idx++;
+    }
+
+    MapSet(vm, vm->allModules, NUM_TO_VALUE(0), VT_TO_VALUE(VT_NULL));
+    StartGC(vm);
+    EXPECT_EQ(vm->largeSpace.count, 0u);
+    EXPECT_EQ(vm->largeSpace.mappedBytes, 0u);
+}
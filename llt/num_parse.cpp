@@ -0,0 +1,96 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-26 11:18:40
+ * @Description: 十进制串转双精度数，以及十六进制和八进制整数
+ */
+#include "gtest/gtest.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// 头文件中用class作成员名，在C++中是关键字，包含时换个名字
+#define class klass
+extern "C" {
+#include "dtoa.h"
+#include "num_parse.h"
+}
+#undef class
+
+static std::string Format(double num)
+{
+    char buf[DTOA_BUFFER_SIZE];
+    uint32_t length = FormatDouble(buf, num);
+    EXPECT_EQ(length, strlen(buf));
+    return std::string(buf, length);
+}
+
+static double Parse(const char *str, boolean *overflow)
+{
+    double num = 0;
+    uint32_t length = strlen(str);
+    EXPECT_EQ(ParseDouble(str, length, &num, overflow), length);
+    return num;
+}
+
+/**
+ * @brief 格式化的结果解析回来是同一个数
+*/
+TEST(NumParse, FormatParseRoundTrip)
+{
+    uint64_t state = 88172645463325252ULL;
+    uint32_t idx = 0;
+    while (idx < 100000) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        double num;
+        memcpy(&num, &state, sizeof(num));
+        idx++;
+        if (isnan(num) || isinf(num)) {
+            continue;
+        }
+        std::string text = Format(num);
+        boolean overflow;
+        double parsed = Parse(text.c_str(), &overflow);
+        EXPECT_FALSE(overflow);
+        ASSERT_EQ(memcmp(&parsed, &num, sizeof(num)), 0) << text;
+    }
+}
+
+TEST(NumParse, ParseDoubleOverflow)
+{
+    boolean overflow;
+    EXPECT_EQ(Parse("1.7976931348623157e308", &overflow), 1.7976931348623157e308);
+    EXPECT_FALSE(overflow);
+    EXPECT_TRUE(isinf(Parse("1.8e308", &overflow)));
+    EXPECT_TRUE(overflow);
+    EXPECT_TRUE(isinf(Parse("-1e400", &overflow)));
+    EXPECT_TRUE(overflow);
+    // 下溢到0不算溢出
+    EXPECT_EQ(Parse("1e-400", &overflow), 0);
+    EXPECT_FALSE(overflow);
+    EXPECT_EQ(Parse("4.9e-324", &overflow), 5e-324);
+    EXPECT_EQ(Parse("9007199254740993", &overflow), 9007199254740992.0);
+
+    double num;
+    EXPECT_EQ(ParseDouble("12abc", 5, &num, &overflow), 2u);
+    EXPECT_EQ(num, 12);
+    EXPECT_EQ(ParseDouble("abc", 3, &num, &overflow), 0u);
+}
+
+TEST(NumParse, ParseHexAndOctal)
+{
+    boolean overflow;
+    EXPECT_EQ(Parse("0x1F", &overflow), 31);
+    EXPECT_EQ(Parse("-0x10", &overflow), -16);
+
+    EXPECT_EQ(ParseInteger("ff", 2, 16), 255);
+    EXPECT_EQ(ParseInteger("FFFFFFFFFFFFFFFF", 16, 16), 18446744073709551615.0);
+    // 超出uint64_t的部分以double继续累加
+    EXPECT_EQ(ParseInteger("10000000000000000", 17, 16), ldexp(1, 64));
+    EXPECT_EQ(ParseInteger("17", 2, 8), 15);
+    EXPECT_EQ(ParseInteger("777", 3, 8), 511);
+    EXPECT_EQ(ParseInteger("2000000000000000000000", 22, 8), ldexp(1, 64));
+}
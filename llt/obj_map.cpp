@@ -0,0 +1,357 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-06-02 14:20:31
+ * @Description: map和集合的查找、删除、墓碑、插入顺序、模式切换、缩容和集合运算
+ */
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// 头文件中用class作成员名，在C++中是关键字，包含时换个名字
+#define class klass
+extern "C" {
+#include "vm.h"
+#include "obj_map.h"
+#include "obj_string.h"
+}
+#undef class
+
+class ObjMapTest: public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            // 与NewVM一样用malloc，不依赖清零的内存
+            vm = (VM *)malloc(sizeof(VM));
+            InitVM(vm);
+        }
+
+        void TearDown() override
+        {
+            FreeVM(vm);
+        }
+
+        // 整数下标传给NUM_TO_VALUE在C++中是收窄转换，统一经double传入
+        Value Num(double num)
+        {
+            return NUM_TO_VALUE(num);
+        }
+
+        void Set(ObjMap *objMap, double key, double value)
+        {
+            MapSet(vm, objMap, Num(key), Num(value));
+        }
+
+        void Add(ObjMap *objSet, double key)
+        {
+            MapSet(vm, objSet, Num(key), VT_TO_VALUE(VT_TRUE));
+        }
+
+        boolean Has(ObjMap *objMap, double key)
+        {
+            return !VALUE_IS_UNDEFINED(MapGet(vm, objMap, Num(key)));
+        }
+
+        // 按存放顺序取出在用的key
+        std::vector<double> Keys(ObjMap *objMap)
+        {
+            std::vector<double> keys;
+            uint32_t idx = 0;
+            while (idx < objMap->entryCount) {
+                if (MAP_ENTRY_IS_LIVE(objMap, idx)) {
+                    keys.push_back(MAP_ENTRY_KEY(objMap, idx).num);
+                }
+                idx++;
+            }
+            return keys;
+        }
+
+        Value Str(const char *str)
+        {
+            return OBJ_TO_VALUE(NewObjString(vm, str, strlen(str)));
+        }
+
+        VM *vm;
+};
+
+/**
+ * @brief 字符串key用另建的同内容字符串也能查到
+*/
+TEST_F(ObjMapTest, StringKeys)
+{
+    ObjMap *objMap = NewObjMap(vm);
+    char key[16];
+    uint32_t idx = 0;
+    while (idx < 100) {
+        snprintf(key, sizeof(key), "key%u", idx);
+        MapSet(vm, objMap, Str(key), Num(idx));
+        idx++;
+    }
+    EXPECT_EQ(objMap->count, 100u);
+    idx = 0;
+    while (idx < 100) {
+        snprintf(key, sizeof(key), "key%u", idx);
+        EXPECT_EQ(MapGet(vm, objMap, Str(key)).num, idx);
+        idx++;
+    }
+    EXPECT_TRUE(VALUE_IS_UNDEFINED(MapGet(vm, objMap, Str("key100"))));
+    EXPECT_EQ(RemoveKey(vm, objMap, Str("key7")).num, 7);
+    EXPECT_TRUE(VALUE_IS_UNDEFINED(MapGet(vm, objMap, Str("key7"))));
+    EXPECT_EQ(MapGet(vm, objMap, Str("key8")).num, 8);
+}
+
+/**
+ * @brief 删除后重新插入同一批key，探测越过墓碑仍能找到
+*/
+TEST_F(ObjMapTest, RemoveReinsertTombstones)
+{
+    ObjMap *objMap = NewObjMap(vm);
+    uint32_t idx = 1;
+    while (idx <= 200) {
+        Set(objMap, idx, idx);
+        idx++;
+    }
+
+    uint32_t round = 0;
+    while (round < 1000) {
+        double key = round % 200 + 1;
+        EXPECT_EQ(RemoveKey(vm, objMap, Num(key)).num, key);
+        EXPECT_FALSE(Has(objMap, key));
+        Set(objMap, key, key);
+        EXPECT_EQ(MapGet(vm, objMap, Num(key)).num, key);
+        EXPECT_LE(objMap->entryCount, objMap->entryCapacity);
+        round++;
+    }
+    EXPECT_EQ(objMap->count, 200u);
+    idx = 1;
+    while (idx <= 200) {
+        EXPECT_EQ(MapGet(vm, objMap, Num(idx)).num, idx);
+        idx++;
+    }
+    EXPECT_EQ(RemoveKey(vm, objMap, Num(1000)).valueType, VT_NULL);
+}
+
+/**
+ * @brief 从0起连续的key按数组存放，出现别的key后转小map，再多转哈希表
+*/
+TEST_F(ObjMapTest, ModeSmallArrayHash)
+{
+    ObjMap *objMap = NewObjMap(vm);
+    EXPECT_EQ(objMap->mode, MAP_MODE_SMALL);
+
+    uint32_t idx = 0;
+    while (idx < 6) {
+        Set(objMap, idx, idx * 10);
+        idx++;
+    }
+    EXPECT_EQ(objMap->mode, MAP_MODE_ARRAY);
+    EXPECT_EQ(objMap->keys, nullptr);
+
+    // 不连续的key使数组转为小map，值不变
+    Set(objMap, 100, 1);
+    EXPECT_EQ(objMap->mode, MAP_MODE_SMALL);
+    EXPECT_EQ(MapGet(vm, objMap, Num(3)).num, 30);
+
+    while (idx < 20) {
+        Set(objMap, idx, idx * 10);
+        idx++;
+    }
+    EXPECT_EQ(objMap->mode, MAP_MODE_HASH);
+    EXPECT_EQ(objMap->count, 21u);
+
+    // 删到只剩少数key时退回小map
+    idx = 0;
+    while (idx < 17) {
+        EXPECT_EQ(RemoveKey(vm, objMap, Num(idx)).num, idx * 10);
+        idx++;
+    }
+    EXPECT_EQ(objMap->mode, MAP_MODE_SMALL);
+    EXPECT_EQ(objMap->count, 4u);
+    EXPECT_EQ(MapGet(vm, objMap, Num(19)).num, 190);
+    EXPECT_EQ(MapGet(vm, objMap, Num(100)).num, 1);
+}
+
+/**
+ * @brief 数组中删除留下的空位过半时转为小map，末尾的删除只截短数组
+*/
+TEST_F(ObjMapTest, ModeArrayHoles)
+{
+    ObjMap *objMap = NewObjMap(vm);
+    uint32_t idx = 0;
+    while (idx < 10) {
+        Set(objMap, idx, idx);
+        idx++;
+    }
+    RemoveKey(vm, objMap, Num(9));
+    EXPECT_EQ(objMap->mode, MAP_MODE_ARRAY);
+    EXPECT_EQ(objMap->entryCount, 9u);
+    Set(objMap, 9, 9);
+    EXPECT_EQ(objMap->mode, MAP_MODE_ARRAY);
+
+    idx = 0;
+    while (idx < 6) {
+        RemoveKey(vm, objMap, Num(idx));
+        idx++;
+    }
+    EXPECT_EQ(objMap->mode, MAP_MODE_SMALL);
+    EXPECT_EQ(Keys(objMap), std::vector<double>({ 6, 7, 8, 9 }));
+
+    // 删空后回到空的小map，又能从0起按数组存放
+    while (idx < 10) {
+        RemoveKey(vm, objMap, Num(idx));
+        idx++;
+    }
+    EXPECT_EQ(objMap->count, 0u);
+    EXPECT_EQ(objMap->mode, MAP_MODE_SMALL);
+    Set(objMap, 0, 1);
+    EXPECT_EQ(objMap->mode, MAP_MODE_ARRAY);
+}
+
+/**
+ * @brief 扩容和清墓碑的重建都保持插入顺序
+*/
+TEST_F(ObjMapTest, OrderAfterRebuild)
+{
+    ObjMap *objMap = NewObjMap(vm);
+    std::vector<double> order;
+    uint32_t idx = 0;
+    while (idx < 300) {
+        double key = (idx * 37) % 300 + 1000;
+        Set(objMap, key, idx);
+        order.push_back(key);
+        idx++;
+    }
+    EXPECT_EQ(Keys(objMap), order);
+
+    // 删掉大半，留下的空位多于在用的key时重建
+    std::vector<double> kept;
+    idx = 0;
+    while (idx < order.size()) {
+        if (idx % 3 == 0) {
+            kept.push_back(order[idx]);
+        } else {
+            RemoveKey(vm, objMap, Num(order[idx]));
+        }
+        idx++;
+    }
+    EXPECT_LT(objMap->entryCount, order.size());
+    EXPECT_EQ(Keys(objMap), kept);
+
+    // 更新已有key不改变顺序
+    Set(objMap, kept[0], -1);
+    EXPECT_EQ(Keys(objMap), kept);
+    EXPECT_EQ(MapGet(vm, objMap, Num(kept[0])).num, -1);
+}
+
+/**
+ * @brief 大量删除后缩容，在缩容边界上反复增删不会反复缩容扩容
+*/
+TEST_F(ObjMapTest, ShrinkHysteresis)
+{
+    ObjMap *objMap = NewObjMap(vm);
+    uint32_t idx = 1;
+    while (idx <= 4096) {
+        Set(objMap, idx, idx);
+        idx++;
+    }
+    uint32_t bigCapacity = objMap->capacity;
+
+    idx = 1;
+    while (idx <= 4000) {
+        RemoveKey(vm, objMap, Num(idx));
+        idx++;
+    }
+    EXPECT_EQ(objMap->mode, MAP_MODE_HASH);
+    EXPECT_LT(objMap->capacity, bigCapacity);
+
+    uint32_t capacity = objMap->capacity;
+    uint32_t changes = 0;
+    uint32_t round = 0;
+    while (round < 10000) {
+        Set(objMap, -1, 0);
+        RemoveKey(vm, objMap, Num(-1));
+        RemoveKey(vm, objMap, Num(4096));
+        Set(objMap, 4096, 4096);
+        if (objMap->capacity != capacity) {
+            changes++;
+            capacity = objMap->capacity;
+        }
+        round++;
+    }
+    EXPECT_LE(changes, 1u);
+    EXPECT_EQ(objMap->count, 96u);
+}
+
+/**
+ * @brief 删除后重新插入使keys用完时，在用的key接近装载上限才扩容一次，之后只按原容量清墓碑
+*/
+TEST_F(ObjMapTest, ChurnBoundedRebuilds)
+{
+    ObjMap *objMap = NewObjMap(vm);
+    uint32_t idx = 1;
+    while (idx <= 200) {
+        Set(objMap, idx, idx);
+        idx++;
+    }
+    uint32_t capacity = objMap->capacity;
+    uint32_t changes = 0;
+    uint32_t round = 0;
+    while (round < 10000) {
+        double key = round % 200 + 1;
+        RemoveKey(vm, objMap, Num(key));
+        Set(objMap, key, key);
+        // 墓碑不多于keys中的空位，不会无限累积
+        EXPECT_LE(objMap->entryCount, objMap->entryCapacity);
+        if (objMap->capacity != capacity) {
+            changes++;
+            capacity = objMap->capacity;
+        }
+        round++;
+    }
+    EXPECT_LE(changes, 1u);
+    EXPECT_EQ(objMap->count, 200u);
+}
+
+/**
+ * @brief 数组模式集合的并、交、差
+*/
+TEST_F(ObjMapTest, SetOperationsArrayMode)
+{
+    ObjMap *a = NewObjSet(vm);
+    ObjMap *b = NewObjSet(vm);
+    uint32_t idx = 0;
+    while (idx < 10) {
+        Add(a, idx);
+        Add(b, idx + 5);
+        idx++;
+    }
+    EXPECT_EQ(a->mode, MAP_MODE_ARRAY);
+    EXPECT_EQ(b->mode, MAP_MODE_HASH);
+    EXPECT_TRUE(Has(a, 9));
+    EXPECT_FALSE(Has(a, 10));
+
+    ObjMap *result = SetUnion(vm, a, b);
+    EXPECT_EQ(Keys(result), std::vector<double>({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14 }));
+    EXPECT_EQ(result->mode, MAP_MODE_ARRAY);
+
+    result = SetIntersect(vm, a, b);
+    EXPECT_EQ(Keys(result), std::vector<double>({ 5, 6, 7, 8, 9 }));
+
+    result = SetDifference(vm, a, b);
+    EXPECT_EQ(Keys(result), std::vector<double>({ 0, 1, 2, 3, 4 }));
+    EXPECT_TRUE(Has(result, 4));
+    EXPECT_FALSE(Has(result, 5));
+
+    // b很小时复制a再删除，删到只剩末尾之前的元素
+    ObjMap *tail = NewObjSet(vm);
+    Add(tail, 8);
+    Add(tail, 9);
+    result = SetDifference(vm, a, tail);
+    EXPECT_EQ(result->mode, MAP_MODE_ARRAY);
+    EXPECT_EQ(Keys(result), std::vector<double>({ 0, 1, 2, 3, 4, 5, 6, 7 }));
+
+    // 运算不改变操作数
+    EXPECT_EQ(a->count, 10u);
+    EXPECT_EQ(b->count, 10u);
+}
@@ -0,0 +1,197 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-05 15:27:09
+ * @Description: 字符串驻留表清扫后的墓碑、探测链、重新驻留、缩容和墓碑复用
+ */
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <set>
+#include <string>
+#include <vector>
+
+// 头文件中用class作成员名，在C++中是关键字，包含时换个名字
+#define class klass
+extern "C" {
+#include "vm.h"
+#include "heap.h"
+#include "obj_string.h"
+}
+#undef class
+
+class StringTableTest: public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            vm = (VM *)malloc(sizeof(VM));
+            InitVM(vm);
+            // 虚拟机初始化时驻留的字符串，每次清扫都保留
+            uint32_t idx = 0;
+            while (idx < vm->strings.capacity) {
+                if (STRING_TABLE_ENTRY_IS_LIVE(vm->strings.strings[idx])) {
+                    baseStrings.insert(vm->strings.strings[idx]);
+                }
+                idx++;
+            }
+        }
+
+        void TearDown() override
+        {
+            FreeVM(vm);
+        }
+
+        static std::string Text(uint32_t idx)
+        {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "interned-%u", idx);
+            return std::string(buf);
+        }
+
+        ObjString *Intern(uint32_t idx)
+        {
+            std::string text = Text(idx);
+            return InternString(vm, text.c_str(), text.size());
+        }
+
+        // 模拟一次标记：只标记初始字符串和survivors，然后清扫驻留表
+        void Sweep(const std::vector<ObjString *> &survivors)
+        {
+            HeapClearMarks(&vm->heap);
+            for (ObjString *objString : baseStrings) {
+                HeapMark(objString);
+            }
+            for (ObjString *objString : survivors) {
+                HeapMark(objString);
+            }
+            SweepStringTable(&vm->strings);
+            HeapClearMarks(&vm->heap);
+        }
+
+        // 在用和墓碑的位置合计不超过装载上限，计数与表中内容相符
+        void ExpectTableConsistent()
+        {
+            StringTable *table = &vm->strings;
+            uint32_t live = 0;
+            uint32_t tombstones = 0;
+            uint32_t idx = 0;
+            while (idx < table->capacity) {
+                if (STRING_TABLE_ENTRY_IS_LIVE(table->strings[idx])) {
+                    live++;
+                } else if (table->strings[idx] == STRING_TABLE_TOMBSTONE) {
+                    tombstones++;
+                }
+                idx++;
+            }
+            EXPECT_EQ(live, table->count);
+            EXPECT_EQ(tombstones, table->tombstoneNum);
+            EXPECT_LE(table->count + table->tombstoneNum, table->capacity * STRING_TABLE_LOAD_PERCENT);
+        }
+
+        VM *vm;
+        std::set<ObjString *> baseStrings;
+};
+
+/**
+ * @brief 未标记的字符串换成墓碑，容量不变；越过墓碑仍能找到探测链后面的存活字符串，
+ *          已回收内容重新驻留得到新对象并复用墓碑
+*/
+TEST_F(StringTableTest, SweepLeavesTombstones)
+{
+    uint32_t baseNum = vm->strings.count;
+    std::vector<ObjString *> all;
+    std::vector<ObjString *> survivors;
+    uint32_t idx = 0;
+    while (idx < 1000) {
+        ObjString *objString = Intern(idx);
+        all.push_back(objString);
+        if (idx % 2 == 0) {
+            survivors.push_back(objString);
+        }
+        idx++;
+    }
+    uint32_t capacity = vm->strings.capacity;
+    ASSERT_GE(baseNum + 500, capacity * STRING_TABLE_LOAD_PERCENT / STRING_TABLE_SHRINK_DIVISOR);
+
+    Sweep(survivors);
+    EXPECT_EQ(vm->strings.capacity, capacity);
+    EXPECT_EQ(vm->strings.count, baseNum + 500);
+    EXPECT_EQ(vm->strings.tombstoneNum, 500u);
+    ExpectTableConsistent();
+
+    idx = 0;
+    while (idx < 1000) {
+        if (idx % 2 == 0) {
+            EXPECT_EQ(Intern(idx), all[idx]);
+        }
+        idx++;
+    }
+    EXPECT_EQ(vm->strings.count, baseNum + 500);
+
+    idx = 1;
+    while (idx < 1000) {
+        ObjString *objString = Intern(idx);
+        EXPECT_NE(objString, all[idx]);
+        EXPECT_EQ(Intern(idx), objString);
+        idx += 2;
+    }
+    EXPECT_EQ(vm->strings.count, baseNum + 1000);
+    EXPECT_LT(vm->strings.tombstoneNum, 500u);
+    ExpectTableConsistent();
+}
+
+/**
+ * @brief 存活的很少时清扫后缩容，墓碑随重建清除
+*/
+TEST_F(StringTableTest, ShrinkWhenSparse)
+{
+    std::vector<ObjString *> survivors;
+    uint32_t idx = 0;
+    while (idx < 4000) {
+        ObjString *objString = Intern(idx);
+        if (idx % 400 == 0) {
+            survivors.push_back(objString);
+        }
+        idx++;
+    }
+    uint32_t capacity = vm->strings.capacity;
+
+    Sweep(survivors);
+    EXPECT_LT(vm->strings.capacity, capacity);
+    EXPECT_EQ(vm->strings.count, baseStrings.size() + survivors.size());
+    EXPECT_EQ(vm->strings.tombstoneNum, 0u);
+    ExpectTableConsistent();
+    idx = 0;
+    while (idx < survivors.size()) {
+        EXPECT_EQ(Intern(idx * 400), survivors[idx]);
+        idx++;
+    }
+}
+
+/**
+ * @brief 反复驻留又回收，墓碑被复用或随重建清除，容量不随轮数增长
+*/
+TEST_F(StringTableTest, ChurnStaysBounded)
+{
+    uint32_t next = 0;
+    uint32_t maxCapacity = 0;
+    uint32_t round = 0;
+    while (round < 200) {
+        uint32_t idx = 0;
+        while (idx < 300) {
+            Intern(next++);
+            idx++;
+        }
+        if (vm->strings.capacity > maxCapacity) {
+            maxCapacity = vm->strings.capacity;
+        }
+        Sweep(std::vector<ObjString *>());
+        EXPECT_EQ(vm->strings.count, baseStrings.size());
+        round++;
+    }
+    ExpectTableConsistent();
+    EXPECT_LE(maxCapacity, 2048u);
+    // 墓碑之后没有遗留的过期项，新驻留的与初始字符串都能找到
+    for (ObjString *objString : baseStrings) {
+        EXPECT_EQ(InternString(vm, STRING_START(objString), objString->value.length), objString);
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * @Author: LiuHao
+ * @Date: 2024-05-19 16:40:08
+ * @Description: 正向截取UTF-8串时的连续字节段
+ */
+#include "gtest/gtest.h"
+
+#include <string>
+
+// 头文件中用class作成员名，在C++中是关键字，包含时换个名字
+#define class klass
+extern "C" {
+#include "unicode.h"
+}
+#undef class
+
+// 与core.c中逐个字符解码再编码的截取结果相同
+static std::string DecodeSub(const std::string &str, uint32_t startIndex, uint32_t count)
+{
+    const uint8_t *source = (const uint8_t *)str.data();
+    std::string result;
+    uint32_t idx = 0;
+    while (idx < count) {
+        uint32_t index = startIndex + idx;
+        int codePoint = DecodeUtf8(source + index, str.size() - index);
+        if (codePoint != -1) {
+            uint8_t buf[4];
+            result.append((const char *)buf, EncodeUtf8(buf, codePoint));
+        }
+        idx++;
+    }
+    return result;
+}
+
+static boolean Span(const std::string &str, uint32_t startIndex, uint32_t count, std::string *span)
+{
+    uint32_t spanStart;
+    uint32_t spanEnd;
+    if (!FindUtf8Span((const uint8_t *)str.data(), str.size(), startIndex, count, &spanStart, &spanEnd)) {
+        return false;
+    }
+    *span = str.substr(spanStart, spanEnd - spanStart);
+    return true;
+}
+
+TEST(Unicode, Utf8SpanValid)
+{
+    std::string str = "a中文b";
+    std::string span;
+    ASSERT_TRUE(Span(str, 0, str.size(), &span));
+    EXPECT_EQ(span, str);
+    // 从字符中间开始，跳过该字符剩下的字节
+    ASSERT_TRUE(Span(str, 2, 4, &span));
+    EXPECT_EQ(span, "文");
+    // 末字节所在字符完整保留
+    ASSERT_TRUE(Span(str, 0, 2, &span));
+    EXPECT_EQ(span, "a中");
+    ASSERT_TRUE(Span(str, 2, 2, &span));
+    EXPECT_EQ(span, "");
+}
+
+/**
+ * @brief 字符之间多出的后续字节在解码时被丢弃，不能按切片保留
+*/
+TEST(Unicode, Utf8SpanStrayContinuation)
+{
+    std::string span;
+    EXPECT_FALSE(Span("a\x80" "b", 0, 3, &span));
+    EXPECT_FALSE(Span("中\x80文", 0, 7, &span));
+    EXPECT_FALSE(Span("a\xe4\xb8", 0, 3, &span));
+    // 起点前的后续字节属于前一个字符
+    ASSERT_TRUE(Span("\x80\x80" "ab", 0, 4, &span));
+    EXPECT_EQ(span, "ab");
+}
+
+/**
+ * @brief 随机字节串上，能取切片时结果与逐个字符解码相同
+*/
+TEST(Unicode, Utf8SpanMatchesDecode)
+{
+    static const char *pieces[] = { "a", "é", "中", "\U0001f600", "\x80", "\xbf", "\xe4\xb8", "\xff" };
+    uint64_t state = 88172645463325252ULL;
+    uint32_t round = 0;
+    while (round < 20000) {
+        std::string str;
+        uint32_t idx = 0;
+        while (idx < 6) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            str += pieces[state % 8];
+            idx++;
+        }
+        uint32_t startIndex = (uint32_t)(state >> 8) % str.size();
+        uint32_t count = (uint32_t)(state >> 24) % (str.size() - startIndex) + 1;
+        std::string span;
+        if (Span(str, startIndex, count, &span)) {
+            ASSERT_EQ(span, DecodeSub(str, startIndex, count));
+        }
+        round++;
+    }
+}
@@ -26,6 +26,7 @@ static void RunFile(const char *path)
     const char *sourceCode = ReadFile(path);  // 读取源码
     LOG_SHOW(YELLOW"Input File PathName: %s" NONE, path);
     ExecuteModule(vm, OBJ_TO_VALUE(NewObjString(vm, path, strlen(path))), sourceCode);
+    FreeVM(vm);
 }
 
 int main(int argc, const char **argv)
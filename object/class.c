@@ -29,15 +29,20 @@ boolean ValueIsEqual(Value a, Value b)
     if (a.objHeader == b.objHeader) {
         return true;
     }
-    if (a.objHeader->type != b.objHeader->type) {
+    if (OBJ_TYPE(a.objHeader) != OBJ_TYPE(b.objHeader)) {
         return false;
     }
-    if (a.objHeader->type == OT_STRING) {
+    if (OBJ_TYPE(a.objHeader) == OT_STRING) {
         ObjString *strA = VALUE_TO_OBJSTR(a);
         ObjString *strB = VALUE_TO_OBJSTR(b);
-        return (strA->value.length == strB->value.length && memcmp(strA->value.start, strB->value.start, strA->value.length) == 0);
+        // 驻留字符串相等时已在上面按指针判定，哈希码都已算出且不同的必然不等
+        if (strA->hashCode != STRING_HASH_UNSET && strB->hashCode != STRING_HASH_UNSET &&
+            strA->hashCode != strB->hashCode) {
+            return false;
+        }
+        return (strA->value.length == strB->value.length && memcmp(STRING_START(strA), STRING_START(strB), strA->value.length) == 0);
     }
-    if (a.objHeader->type == OT_RANGE) {
+    if (OBJ_TYPE(a.objHeader) == OT_RANGE) {
         ObjRange *rgA = VALUE_TO_OBJRANGE(a);
         ObjRange *rgB = VALUE_TO_OBJRANGE(b);
         return (rgA->from == rgB->from && rgA->to == rgB->to);
@@ -51,9 +56,9 @@ boolean ValueIsEqual(Value a, Value b)
 */
 Class* NewRawClass(VM *vm, const char *name, uint32_t fieldNum)
 {
-    Class *class = ALLOCATE(vm, Class);
+    Class *class = ALLOCATE_OBJ(vm, Class);
     InitObjHeader(vm, &class->objHeader, OT_CLASS, NULL);
-    class->name = NewObjString(vm, name, strlen(name));
+    class->name = InternString(vm, name, strlen(name));
     class->fieldNum = fieldNum;
     class->superClass = NULL; // 默认无父类
     MethodBufferInit(&class->methods);
@@ -75,7 +80,7 @@ inline Class* GetClassOfObj(VM *vm, Value object)
         case VT_NUM:
             return vm->numClass;
         case VT_OBJ:
-            return VALUE_TO_OBJ(object)->class;
+            return OBJ_CLASS(VALUE_TO_OBJ(object));
         default:
             NOT_REACHED()
     }
@@ -90,15 +95,15 @@ Class* NewClass(VM *vm, ObjString *className, uint32_t fieldNum, Class *superCla
     #define MAX_METACLASS_LEN MAX_ID_LEN + 10
     char newClassName[MAX_METACLASS_LEN] = {'\0'};
     #undef MAX_METACLASS_LEN
-    memcpy(newClassName, className->value.start, className->value.length);
+    memcpy(newClassName, STRING_START(className), className->value.length);
     memcpy(newClassName + className->value.length, "metaclass", 10U);
     Class *metaClass = NewRawClass(vm, newClassName, 0);
-    metaClass->objHeader.class = vm->classOfClass;
+    SET_OBJ_CLASS(metaClass, vm->classOfClass);
     BindSuperClass(vm, metaClass, vm->classOfClass);
-    memcpy(newClassName, className->value.start, className->value.length);
+    memcpy(newClassName, STRING_START(className), className->value.length);
     newClassName[className->value.length] = '\0';
     Class *class = NewRawClass(vm, newClassName, fieldNum);
-    class->objHeader.class = metaClass;
+    SET_OBJ_CLASS(class, metaClass);
     BindSuperClass(vm, class, superClass);
     return class;
 }
@@ -48,6 +48,7 @@ typedef enum {
 #define VALUE_TO_OBJINSTANCE(value)     ((ObjInstance *)VALUE_TO_OBJ(value))
 #define VALUE_TO_OBJLIST(value)         ((ObjList *)VALUE_TO_OBJ(value))
 #define VALUE_TO_OBJMAP(value)          ((ObjMap *)VALUE_TO_OBJ(value))
+#define VALUE_TO_OBJSET(value)          ((ObjMap *)VALUE_TO_OBJ(value))
 #define VALUE_TO_OBJTHREAD(value)       ((ObjThread *)VALUE_TO_OBJ(value))
 #define VALUE_TO_OBJMODULE(value)       ((ObjModule *)VALUE_TO_OBJ(value))
 
@@ -57,12 +58,14 @@ typedef enum {
 #define VALUE_IS_FALSE(value)     ((value).valueType == VT_FALSE)
 #define VALUE_IS_NUM(value)       ((value).valueType == VT_NUM)
 #define VALUE_IS_OBJ(value)       ((value).valueType == VT_OBJ)
-#define VALUE_IS_CERTAIN_OBJ(value, objType)   (VALUE_IS_OBJ(value) && VALUE_TO_OBJ(value)->type == objType)
+#define VALUE_IS_CERTAIN_OBJ(value, objType)   (VALUE_IS_OBJ(value) && OBJ_TYPE(VALUE_TO_OBJ(value)) == objType)
 #define VALUE_IS_OBJSTR(value)                  (VALUE_IS_CERTAIN_OBJ(value, OT_STRING))
 #define VALUE_IS_OBJINSTANCE(value)             (VALUE_IS_CERTAIN_OBJ(value, OT_INSTANCE))
 #define VALUE_IS_OBJCLOSURE(value)              (VALUE_IS_CERTAIN_OBJ(value, OT_CLOSURE))
 #define VALUE_IS_OBJRANGE(value)                (VALUE_IS_CERTAIN_OBJ(value, OT_RANGE))
 #define VALUE_IS_CLASS(value)                   (VALUE_IS_CERTAIN_OBJ(value, OT_CLASS))
+#define VALUE_IS_OBJMAP(value)                  (VALUE_IS_CERTAIN_OBJ(value, OT_MAP))
+#define VALUE_IS_OBJSET(value)                  (VALUE_IS_CERTAIN_OBJ(value, OT_SET))
 #define VALUE_IS_0(value)                       (VALUE_IS_NUM(value) && (value).num == 0)
 
 // 原生方法指针
@@ -14,7 +14,7 @@
 */
 ObjModule* NewObjModule(VM *vm, const char *modName)
 {
-    ObjModule *objModule = ALLOCATE(vm, ObjModule); // ALLOCATE用于申请内存
+    ObjModule *objModule = ALLOCATE_OBJ(vm, ObjModule); // ALLOCATE用于申请内存
     if (objModule == NULL) {
         MEM_ERROR("Allocate ObjModule Failed!");
     }
@@ -27,7 +27,7 @@ ObjModule* NewObjModule(VM *vm, const char *modName)
 
     objModule->name = NULL; // 核心模块名为NULL
     if (modName != NULL) {
-        objModule->name = NewObjString(vm, modName, strlen(modName));
+        objModule->name = InternString(vm, modName, strlen(modName));
     }
 
     return objModule;
@@ -38,7 +38,7 @@ ObjModule* NewObjModule(VM *vm, const char *modName)
 */
 ObjInstance* NewObjInstance(VM *vm, Class *myClass)
 {
-    ObjInstance *objInstance = ALLOCATE_EXTRA(vm, ObjInstance, sizeof(Value) * myClass->fieldNum);
+    ObjInstance *objInstance = ALLOCATE_OBJ_EXTRA(vm, ObjInstance, sizeof(Value) * myClass->fieldNum);
 
     InitObjHeader(vm, &objInstance->objHeader, OT_INSTANCE, myClass);
     // 初始化field为NULL
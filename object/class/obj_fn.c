@@ -13,7 +13,7 @@
 */
 ObjUpvalue* NewObjUpvalue(VM *vm, Value *localVarPtr)
 {
-    ObjUpvalue *objUpvalue = ALLOCATE(vm, ObjUpvalue);
+    ObjUpvalue *objUpvalue = ALLOCATE_OBJ(vm, ObjUpvalue);
     InitObjHeader(vm, &objUpvalue->objHeader, OT_UPVALUE, NULL);
     objUpvalue->localVarPtr = localVarPtr;
     objUpvalue->closedUpvalue = VT_TO_VALUE(VT_NULL);
@@ -26,7 +26,7 @@ ObjUpvalue* NewObjUpvalue(VM *vm, Value *localVarPtr)
 */
 ObjClosure* NewObjClosure(VM *vm, ObjFn *objFn)
 {
-    ObjClosure *objClosure = ALLOCATE_EXTRA(vm, ObjClosure, sizeof(ObjUpvalue *) * objFn->upvalueNum);
+    ObjClosure *objClosure = ALLOCATE_OBJ_EXTRA(vm, ObjClosure, sizeof(ObjUpvalue *) * objFn->upvalueNum);
 
     InitObjHeader(vm, &objClosure->objHeader, OT_CLOSURE, vm->fnClass);
     objClosure->fn = objFn;
@@ -45,7 +45,7 @@ ObjClosure* NewObjClosure(VM *vm, ObjFn *objFn)
 */
 ObjFn*NewObjFn(VM *vm, ObjModule *objModule, uint32_t maxStackSlotUsedNum)
 {
-    ObjFn *objFn = ALLOCATE(vm, ObjFn);
+    ObjFn *objFn = ALLOCATE_OBJ(vm, ObjFn);
     if (objFn == NULL) {
         MEM_ERROR("Allocate ObjFn Failed!");
     }
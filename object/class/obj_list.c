@@ -19,7 +19,7 @@ ObjList* NewObjList(VM *vm, uint32_t elementNum)
     if (elementNum > 0) {
         elementArray = ALLOCATE_ARRAY(vm, Value, elementNum);
     }
-    ObjList *objList = ALLOCATE(vm, ObjList);
+    ObjList *objList = ALLOCATE_OBJ(vm, ObjList);
 
     objList->elements.datas = elementArray;
     objList->elements.capacity = objList->elements.count = elementNum;
@@ -82,6 +82,6 @@ static void ShrinkList(VM *vm, ObjList *objList, uint32_t newCapacity)
     uint32_t oldSize = objList->elements.capacity * sizeof(Value);
     uint32_t newSize = newCapacity * sizeof(Value);
 
-    MemManager(vm, objList->elements.datas, oldSize, newSize);
+    objList->elements.datas = (Value *)MemManager(vm, objList->elements.datas, oldSize, newSize);
     objList->elements.capacity = newCapacity;
 }
\ No newline at end of file
@@ -3,43 +3,69 @@
 #include "vm.h"
 #include "obj_string.h"
 #include "obj_range.h"
+#include "hash.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief 创建空的map或集合，objType为OT_MAP或OT_SET
+*/
+static ObjMap* NewEmptyMap(VM *vm, ObjType objType, Class *class)
+{
+    ObjMap *objMap = ALLOCATE_OBJ(vm, ObjMap);
+    InitObjHeader(vm, &objMap->objHeader, objType, class);
+    objMap->mode = MAP_MODE_SMALL;
+    objMap->capacity = objMap->count = objMap->entryCount = objMap->entryCapacity = 0;
+    objMap->keys = objMap->values = NULL;
+    objMap->indices = NULL;
+    objMap->ctrl = NULL;
+    return objMap;
+}
 
 /**
  * @brief 创建新map对象
 */
 ObjMap* NewObjMap(VM *vm)
 {
-    ObjMap *objMap = ALLOCATE(vm, ObjMap);
-    InitObjHeader(vm, &objMap->objHeader, OT_MAP, vm->mapClass);
-    objMap->capacity = objMap->count = 0;
-    objMap->entries = NULL;
-    return objMap;
+    return NewEmptyMap(vm, OT_MAP, vm->mapClass);
+}
+
+/**
+ * @brief 创建新集合对象
+*/
+ObjMap* NewObjSet(VM *vm)
+{
+    return NewEmptyMap(vm, OT_SET, vm->setClass);
 }
 
 /**
- * @brief 计算数字的哈希码
+ * @brief 计算数字的哈希码，与种子混合，外部输入的数字也难以构造冲突
 */
-static uint32_t HashNum(double num)
+static uint32_t HashNum(VM *vm, double num)
 {
     Bits64 bits64;
-    bits64.num = num;
-    return bits64.bits32[0] ^ bits64.bits32[1];
+    // 0和-0相等，哈希码也须相同
+    bits64.num = num == 0 ? 0 : num;
+    uint64_t hash = HashMix(bits64.bits64 ^ vm->hashSeed, 0x9e3779b97f4a7c15ULL);
+    return (uint32_t)(hash ^ (hash >> 32));
 }
 
 /**
  * @brief 计算对象的哈希码
 */
-static uint32_t HashObj(ObjHeader *objHeader)
+static uint32_t HashObj(VM *vm, ObjHeader *objHeader)
 {
-    switch (objHeader->type)
+    switch (OBJ_TYPE(objHeader))
     {
-        case OT_CLASS: // 计算class的哈希值
-            return HashString(((Class *)objHeader)->name->value.start, ((Class *)objHeader)->name->value.length);
+        case OT_CLASS: // 类名的哈希值
+            return HashObjString(vm, ((Class *)objHeader)->name);
         case OT_RANGE:
             ObjRange *objRange = (ObjRange *)objHeader;
-            return HashNum(objRange->from) ^ HashNum(objRange->to);
-        case OT_STRING: // 对于字符串 直接返回其hash_code
-            return ((ObjString *)objHeader)->hashCode;
+            return HashNum(vm, objRange->from) ^ HashNum(vm, objRange->to);
+        case OT_STRING: // 字符串的哈希码首次用到时计算并缓存
+            return HashObjString(vm, (ObjString *)objHeader);
         default:
             RUNTIME_ERROR("The hashable are objstring, objrange and class.");
     }
@@ -49,19 +75,24 @@ static uint32_t HashObj(ObjHeader *objHeader)
 /**
  * @brief 根据value的类型调用相应的哈希函数
 */
-static uint32_t HashValue(Value value)
+static inline uint32_t HashValue(VM *vm, Value value)
 {
+    // 字符串key最常见，已缓存哈希码的直接取
+    if (value.valueType == VT_OBJ && OBJ_TYPE(value.objHeader) == OT_STRING &&
+        ((ObjString *)value.objHeader)->hashCode != STRING_HASH_UNSET) {
+        return ((ObjString *)value.objHeader)->hashCode;
+    }
     switch (value.valueType) {
         case VT_FALSE:
             return 0;
         case VT_NULL:
             return 1;
         case VT_NUM:
-            return HashNum(value.num);
+            return HashNum(vm, value.num);
         case VT_TRUE:
             return 2;
         case VT_OBJ:
-            return HashObj(value.objHeader);
+            return HashObj(vm, value.objHeader);
         default:
             RUNTIME_ERROR("unsupport type hashed!");
     }
@@ -69,117 +100,438 @@ static uint32_t HashValue(Value value)
 }
 
 /**
- * @brief 在entries中添加entry，如果是新的key则返回true
+ * @brief 比较两个key，类型和内容完全相同(驻留字符串即指针相同)的不必调用ValueIsEqual
+*/
+static inline boolean KeyIsEqual(Value a, Value b)
+{
+    if (a.valueType != b.valueType) {
+        return false;
+    }
+    if (a.valueType == VT_NUM) {
+        return a.num == b.num;
+    }
+    if (a.valueType != VT_OBJ || a.objHeader == b.objHeader) {
+        return true;
+    }
+    return ValueIsEqual(a, b);
+}
+
+/**
+ * @brief 容量为capacity时每个槽位中下标的字节数
 */
-static boolean AddEntry(Entry *entries, uint32_t capacity, Value key, Value value)
+static inline uint32_t IndexWidth(uint32_t capacity)
 {
-    uint32_t index = HashValue(key) % capacity;
-    // 开放定址法
+    if (capacity <= MAP_INDEX8_MAX_CAPACITY) {
+        return sizeof(uint8_t);
+    }
+    if (capacity <= MAP_INDEX16_MAX_CAPACITY) {
+        return sizeof(uint16_t);
+    }
+    return sizeof(uint32_t);
+}
+
+/**
+ * @brief mode模式下keys、values、indices和ctrl共占的字节数，capacity为哈希表槽位数
+ *          集合不分配values
+*/
+static uint32_t StorageSize(uint8_t mode, boolean isSet, uint32_t entryCapacity, uint32_t capacity)
+{
+    if (mode == MAP_MODE_ARRAY) {
+        return entryCapacity * sizeof(Value);
+    }
+    uint32_t size = entryCapacity * (isSet ? 1 : 2) * sizeof(Value);
+    if (mode == MAP_MODE_HASH) {
+        size += capacity * IndexWidth(capacity) + capacity + MAP_GROUP_WIDTH - 1;
+    }
+    return size;
+}
+
+/**
+ * @brief objMap的keys、values、indices和ctrl共占的字节数
+*/
+uint32_t MapStorageSize(ObjMap *objMap)
+{
+    return StorageSize(objMap->mode, MAP_IS_SET(objMap), objMap->entryCapacity, objMap->capacity);
+}
+
+/**
+ * @brief 存储块的起始地址，数组模式下没有keys
+*/
+static inline void* StorageOf(ObjMap *objMap)
+{
+    return objMap->mode == MAP_MODE_ARRAY ? (void *)objMap->values : (void *)objMap->keys;
+}
+
+static inline uint32_t GetIndex(ObjMap *objMap, uint32_t slot)
+{
+    if (objMap->capacity <= MAP_INDEX8_MAX_CAPACITY) {
+        return ((uint8_t *)objMap->indices)[slot];
+    }
+    if (objMap->capacity <= MAP_INDEX16_MAX_CAPACITY) {
+        return ((uint16_t *)objMap->indices)[slot];
+    }
+    return ((uint32_t *)objMap->indices)[slot];
+}
+
+static inline void SetIndex(ObjMap *objMap, uint32_t slot, uint32_t index)
+{
+    if (objMap->capacity <= MAP_INDEX8_MAX_CAPACITY) {
+        ((uint8_t *)objMap->indices)[slot] = (uint8_t)index;
+    } else if (objMap->capacity <= MAP_INDEX16_MAX_CAPACITY) {
+        ((uint16_t *)objMap->indices)[slot] = (uint16_t)index;
+    } else {
+        ((uint32_t *)objMap->indices)[slot] = index;
+    }
+}
+
+/**
+ * @brief 组内控制字节等于h的槽位，第i位为1表示第i个
+*/
+static inline uint32_t GroupMatch(const uint8_t *group, uint8_t h)
+{
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8((char)h), ctrl));
+#else
+    uint32_t mask = 0, idx = 0;
+    while (idx < MAP_GROUP_WIDTH) {
+        mask |= (uint32_t)(group[idx] == h) << idx;
+        idx++;
+    }
+    return mask;
+#endif
+}
+
+/**
+ * @brief 组内的空槽位和墓碑，二者最高位都为1
+*/
+static inline uint32_t GroupMatchEmptyOrDeleted(const uint8_t *group)
+{
+#ifdef __SSE2__
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#else
+    uint32_t mask = 0, idx = 0;
+    while (idx < MAP_GROUP_WIDTH) {
+        mask |= (uint32_t)(group[idx] >> 7) << idx;
+        idx++;
+    }
+    return mask;
+#endif
+}
+
+/**
+ * @brief 设置槽位idx的控制字节，开头一组之内的同时更新末尾的镜像
+*/
+static inline void SetCtrl(ObjMap *objMap, uint32_t idx, uint8_t h)
+{
+    objMap->ctrl[idx] = h;
+    if (idx < MAP_GROUP_WIDTH - 1) {
+        objMap->ctrl[objMap->capacity + idx] = h;
+    }
+}
+
+// 哈希值的低7位存入控制字节，其余位决定探测起点
+#define HASH_H1(hash) ((hash) >> 7)
+#define HASH_H2(hash) ((uint8_t)((hash) & 0x7F))
+
+/**
+ * @brief 沿hash的探测序列找第一个空槽位或墓碑
+ *          探测以组为单位，步长依次增加一组，容量为2的幂时能遍历所有组
+*/
+static uint32_t FindInsertSlot(ObjMap *objMap, uint32_t hash)
+{
+    uint32_t mask = objMap->capacity - 1;
+    uint32_t pos = HASH_H1(hash) & mask, stride = 0;
     while (true) {
-        if (entries[index].key.valueType == VT_UNDEFINED) {
-            entries[index].key = key;
-            entries[index].value = value;
-            return true;
+        uint32_t match = GroupMatchEmptyOrDeleted(objMap->ctrl + pos);
+        if (match != 0) {
+            return (pos + (uint32_t)__builtin_ctz(match)) & mask;
         }
-        else if (ValueIsEqual(entries[index].key, key)) {
-            entries[index].value = value;
-            return false;
-        }
-        index = (index + 1) % capacity;
+        stride += MAP_GROUP_WIDTH;
+        pos = (pos + stride) & mask;
     }
 }
 
 /**
- * @brief 使对象objMap的容量调整到new_capacity
+ * @brief 在objMap中查找key所在的槽位，未找到返回UINT32_MAX
 */
-static void ResizeMap(VM *vm, ObjMap *objMap, uint32_t newCapacity)
+static uint32_t FindSlot(ObjMap *objMap, Value key, uint32_t hash)
 {
-    // 先建立一个新的entry数组
-    Entry *newEntries = ALLOCATE_ARRAY(vm, Entry, newCapacity);
-    uint32_t idx = 0;
-    while (idx < newCapacity) {
-        newEntries[idx].key = VT_TO_VALUE(VT_UNDEFINED);
-        newEntries[idx].value =VT_TO_VALUE(VT_FALSE);
-        idx ++;
-    }
-    if (objMap->capacity > 0) {
-        Entry *entryArr = objMap->entries;
-        idx = 0;
-        while (idx < objMap->capacity) {
-            if (entryArr[idx].key.valueType != VT_UNDEFINED) {
-                AddEntry(newEntries, newCapacity, entryArr[idx].key, entryArr[idx].value);
+    uint32_t mask = objMap->capacity - 1;
+    uint32_t pos = HASH_H1(hash) & mask, stride = 0;
+    uint8_t h2 = HASH_H2(hash);
+    while (true) {
+        const uint8_t *group = objMap->ctrl + pos;
+        // 控制字节相同的才比较key，其余的一次排除
+        uint32_t match = GroupMatch(group, h2);
+        while (match != 0) {
+            uint32_t slot = (pos + (uint32_t)__builtin_ctz(match)) & mask;
+            if (KeyIsEqual(objMap->keys[GetIndex(objMap, slot)], key)) {
+                return slot;
             }
-            idx ++;
+            match &= match - 1;
         }
+        // 组内有空槽位说明key从未越过此组插入更远处
+        if (GroupMatch(group, MAP_CTRL_EMPTY) != 0) {
+            return UINT32_MAX;
+        }
+        stride += MAP_GROUP_WIDTH;
+        pos = (pos + stride) & mask;
     }
-    // 把老entry数组空间回收
-    DEALLOCATE_ARRAY(vm, objMap->entries, objMap->count);
-    objMap->entries = newEntries;
-    objMap->capacity = newCapacity;
 }
 
 /**
- * @brief 在objMap中查找key对应的entry
+ * @brief 按mode重建objMap，mode为MAP_MODE_HASH时newCapacity是哈希表槽位数，否则是keys的容量
+ *          在用的key和value按原顺序挤到新keys和values的前部，删除留下的空位和墓碑随之清除
 */
-static Entry* FindEntry(ObjMap *objMap, Value key)
+static void RebuildMap(VM *vm, ObjMap *objMap, uint8_t mode, uint32_t newCapacity)
 {
-    if (objMap->capacity == 0) {
-        return NULL;
+    ASSERT(mode != MAP_MODE_ARRAY, "array mode is never rebuilt!");
+    uint8_t oldMode = objMap->mode;
+    Value *oldKeys = objMap->keys;
+    Value *oldValues = objMap->values;
+    uint32_t oldEntryCount = objMap->entryCount;
+    void *oldStorage = StorageOf(objMap);
+    uint32_t oldSize = MapStorageSize(objMap);
+
+    // keys、values、indices和ctrl一次分配
+    uint32_t capacity = mode == MAP_MODE_HASH ? newCapacity : 0;
+    uint32_t entryCapacity = mode == MAP_MODE_HASH ? MAP_MAX_LOAD(newCapacity) : newCapacity;
+    boolean isSet = MAP_IS_SET(objMap);
+    Value *storage = (Value *)MemManager(vm, NULL, 0, StorageSize(mode, isSet, entryCapacity, capacity));
+    objMap->mode = mode;
+    objMap->keys = storage;
+    objMap->values = isSet ? NULL : storage + entryCapacity;
+    objMap->entryCapacity = entryCapacity;
+    objMap->capacity = capacity;
+    if (mode == MAP_MODE_HASH) {
+        objMap->indices = storage + (isSet ? 1 : 2) * entryCapacity;
+        objMap->ctrl = (uint8_t *)objMap->indices + capacity * IndexWidth(capacity);
+        memset(objMap->ctrl, MAP_CTRL_EMPTY, capacity + MAP_GROUP_WIDTH - 1);
+    } else {
+        objMap->indices = NULL;
+        objMap->ctrl = NULL;
     }
-    // 用开放定址法探测
-    uint32_t index = HashValue(key) % objMap->capacity;
-    Entry *entry;
-    while (true) {
-        entry = &objMap->entries[index];
-        if (ValueIsEqual(entry->key, key)) {
-            return entry;
+
+    // 旧表中的key各不相同，直接放入探测到的第一个空槽位
+    uint32_t idx = 0, index = 0;
+    while (idx < oldEntryCount) {
+        Value key;
+        if (oldMode == MAP_MODE_ARRAY) {
+            key = NUM_TO_VALUE(idx);
+        } else {
+            key = oldKeys[idx];
+        }
+        if (VALUE_IS_UNDEFINED(oldMode == MAP_MODE_ARRAY ? oldValues[idx] : key)) {
+            idx++;
+            continue;
+        }
+        if (mode == MAP_MODE_HASH) {
+            uint32_t hash = HashValue(vm, key);
+            uint32_t slot = FindInsertSlot(objMap, hash);
+            SetCtrl(objMap, slot, HASH_H2(hash));
+            SetIndex(objMap, slot, index);
         }
-        if (VALUE_IS_UNDEFINED(entry->key) && VALUE_IS_FALSE(entry->value)) {
-            return NULL; // 未找到
+        objMap->keys[index] = key;
+        if (!isSet) {
+            objMap->values[index] = oldValues[idx];
         }
-        index = (index + 1) % objMap->capacity;
+        index++;
+        idx++;
+    }
+    objMap->entryCount = index;
+
+    if (oldStorage != NULL) {
+        MemManager(vm, oldStorage, oldSize, 0);
     }
 }
 
 /**
- * @brief 在objMap中实现key和value的关联
+ * @brief 能容纳count个key而不超过装载上限的最小哈希表容量
 */
-void MapSet(VM *vm, ObjMap *objMap, Value key, Value value)
+static uint32_t HashCapacityFor(uint32_t count)
 {
-    if (objMap->count + 1 > objMap->capacity * MAP_LOAD_PERCENT) {
-        uint32_t newCapacity = objMap->capacity * CAPACITY_GROW_FACTOR;
-        if (newCapacity < MIN_CAPACITY) {
-            newCapacity = MIN_CAPACITY;
+    uint32_t capacity = MAP_MIN_CAPACITY;
+    while (MAP_MAX_LOAD(capacity) <= count) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/**
+ * @brief 按key查找其在keys和values中的位置，未找到返回UINT32_MAX
+*/
+static uint32_t FindEntry(VM *vm, ObjMap *objMap, Value key)
+{
+    if (objMap->mode == MAP_MODE_ARRAY) {
+        // 写成取反的形式，nan也不在范围内
+        if (!VALUE_IS_NUM(key) || !(key.num >= 0 && key.num < objMap->entryCount)) {
+            return UINT32_MAX;
         }
-        ResizeMap(vm, objMap, newCapacity);
+        uint32_t index = (uint32_t)key.num;
+        if (index != key.num || VALUE_IS_UNDEFINED(objMap->values[index])) {
+            return UINT32_MAX;
+        }
+        return index;
     }
-    
-    if (AddEntry(objMap->entries, objMap->capacity, key, value)) {
-        objMap->count ++;
+    if (objMap->mode == MAP_MODE_SMALL) {
+        // key很少，逐个比较比计算哈希值还快
+        uint32_t idx = 0;
+        while (idx < objMap->entryCount) {
+            if (KeyIsEqual(objMap->keys[idx], key)) {
+                return idx;
+            }
+            idx++;
+        }
+        return UINT32_MAX;
+    }
+    uint32_t slot = FindSlot(objMap, key, HashValue(vm, key));
+    return slot == UINT32_MAX ? UINT32_MAX : GetIndex(objMap, slot);
+}
+
+/**
+ * @brief 数组模式下追加key为entryCount的value
+*/
+static void ArrayAppend(VM *vm, ObjMap *objMap, Value value)
+{
+    if (objMap->entryCount == objMap->entryCapacity) {
+        uint32_t newCapacity = objMap->entryCapacity * 2;
+        objMap->values = (Value *)MemManager(vm, objMap->values,
+            objMap->entryCapacity * sizeof(Value), newCapacity * sizeof(Value));
+        objMap->entryCapacity = newCapacity;
+    }
+    objMap->values[objMap->entryCount++] = value;
+    objMap->count++;
+}
+
+/**
+ * @brief 确保小map或哈希模式的map还能追加一个key，必要时重建或转换模式
+*/
+static void ReserveEntry(VM *vm, ObjMap *objMap)
+{
+    if (objMap->entryCount < objMap->entryCapacity) {
+        return;
+    }
+    if (objMap->mode == MAP_MODE_SMALL) {
+        if (objMap->count < objMap->entryCount) {
+            // 挤掉删除留下的空位
+            RebuildMap(vm, objMap, MAP_MODE_SMALL, objMap->entryCapacity);
+        } else if (objMap->entryCapacity < MAP_SMALL_MAX) {
+            uint32_t newCapacity = objMap->entryCapacity * 2;
+            RebuildMap(vm, objMap, MAP_MODE_SMALL,
+                newCapacity < MAP_SMALL_MIN_CAPACITY ? MAP_SMALL_MIN_CAPACITY : newCapacity);
+        } else {
+            RebuildMap(vm, objMap, MAP_MODE_HASH, HashCapacityFor(objMap->count + 1));
+        }
+        return;
+    }
+    // keys用完了:删除留下的空位多就按原容量重建，否则扩容一倍
+    // 在用和墓碑槽位都不多于entryCount，因此总留有空槽位，探测必定终止
+    uint32_t newCapacity = objMap->capacity;
+    if (objMap->count >= MAP_MAX_LOAD(objMap->capacity) / 2) {
+        newCapacity *= 2;
+    }
+    RebuildMap(vm, objMap, MAP_MODE_HASH, newCapacity);
+}
+
+/**
+ * @brief 把objMap中没有的key追加在末尾，key须已驻留
+*/
+static void AddEntry(VM *vm, ObjMap *objMap, Value key, Value value)
+{
+    boolean isNextIndex = VALUE_IS_NUM(key) && key.num == objMap->entryCount;
+    if (objMap->mode == MAP_MODE_ARRAY) {
+        if (isNextIndex) {
+            ArrayAppend(vm, objMap, value);
+            return;
+        }
+        // key不再是连续的下标，转为一般的map
+        RebuildMap(vm, objMap, objMap->count < MAP_SMALL_MAX ? MAP_MODE_SMALL : MAP_MODE_HASH,
+            objMap->count < MAP_SMALL_MAX ? MAP_SMALL_MAX : HashCapacityFor(objMap->count + 1));
+    } else if (objMap->entryCapacity == 0 && isNextIndex) {
+        // 空map的第一个key是0时按数组存放
+        objMap->mode = MAP_MODE_ARRAY;
+        objMap->values = ALLOCATE_ARRAY(vm, Value, MAP_ARRAY_MIN_CAPACITY);
+        objMap->entryCapacity = MAP_ARRAY_MIN_CAPACITY;
+        ArrayAppend(vm, objMap, value);
+        return;
+    }
+
+    ReserveEntry(vm, objMap);
+    if (objMap->mode == MAP_MODE_HASH) {
+        uint32_t hash = HashValue(vm, key);
+        uint32_t slot = FindInsertSlot(objMap, hash);
+        SetCtrl(objMap, slot, HASH_H2(hash));
+        SetIndex(objMap, slot, objMap->entryCount);
+    }
+    objMap->keys[objMap->entryCount] = key;
+    if (objMap->values != NULL) {
+        objMap->values[objMap->entryCount] = value;
+    }
+    objMap->entryCount++;
+    objMap->count++;
+}
+
+/**
+ * @brief 在objMap中实现key和value的关联，新key追加在末尾
+ *          objMap是集合时value须为true
+*/
+void MapSet(VM *vm, ObjMap *objMap, Value key, Value value)
+{
+    // 字符串key驻留，之后用驻留字符串查找时按指针即可命中
+    key = InternValue(vm, key);
+    uint32_t index = FindEntry(vm, objMap, key);
+    if (index == UINT32_MAX) {
+        AddEntry(vm, objMap, key, value);
+    } else if (objMap->values != NULL) {
+        objMap->values[index] = value;
     }
 }
 
 /**
  * @brief 从map查找key对应的value
 */
-Value MapGet(ObjMap *objMap, Value key)
+Value MapGet(VM *vm, ObjMap *objMap, Value key)
 {
-    Entry *entry = FindEntry(objMap, key);
-    if (entry == NULL)
-    {
+    if (objMap->count == 0) {
         return VT_TO_VALUE(VT_UNDEFINED);
     }
-    return entry->value;
+    uint32_t index = FindEntry(vm, objMap, key);
+    if (index == UINT32_MAX) {
+        return VT_TO_VALUE(VT_UNDEFINED);
+    }
+    return objMap->values == NULL ? VT_TO_VALUE(VT_TRUE) : objMap->values[index];
 }
 
 /**
- * @brief 回收objMap.entries占用的空间
+ * @brief 回收objMap的keys、values、indices和ctrl占用的空间
 */
 void ClearMap(VM *vm, ObjMap *objMap)
 {
-    DEALLOCATE_ARRAY(vm, objMap->entries, objMap->count);
-    objMap->entries = NULL;
-    objMap->capacity = objMap->count = 0;
+    void *storage = StorageOf(objMap);
+    if (storage != NULL) {
+        MemManager(vm, storage, MapStorageSize(objMap), 0);
+    }
+    objMap->mode = MAP_MODE_SMALL;
+    objMap->keys = objMap->values = NULL;
+    objMap->indices = NULL;
+    objMap->ctrl = NULL;
+    objMap->capacity = objMap->count = objMap->entryCount = objMap->entryCapacity = 0;
+}
+
+/**
+ * @brief 哈希模式下清除槽位slot，能置空的置空，否则留墓碑
+*/
+static void ClearSlot(ObjMap *objMap, uint32_t slot)
+{
+    // 槽位前后的16个控制字节中都有空槽位，且两者间隔不足一组时，
+    // 没有探测序列因为此槽位满而越过，可以直接置空，否则须留墓碑
+    uint32_t mask = objMap->capacity - 1;
+    uint32_t emptyAfter = GroupMatch(objMap->ctrl + slot, MAP_CTRL_EMPTY);
+    uint32_t emptyBefore = GroupMatch(objMap->ctrl + ((slot - MAP_GROUP_WIDTH) & mask), MAP_CTRL_EMPTY);
+    boolean wasNeverFull = emptyAfter != 0 && emptyBefore != 0 &&
+        (uint32_t)__builtin_ctz(emptyAfter) + (uint32_t)(__builtin_clz(emptyBefore) - (32 - MAP_GROUP_WIDTH)) < MAP_GROUP_WIDTH;
+    SetCtrl(objMap, slot, wasNeverFull ? MAP_CTRL_EMPTY : MAP_CTRL_DELETED);
 }
 
 /**
@@ -187,29 +539,162 @@ void ClearMap(VM *vm, ObjMap *objMap)
 */
 Value RemoveKey(VM *vm, ObjMap *objMap, Value key)
 {
-    Entry *entry = FindEntry(objMap, key);
-    if (entry == NULL)
-    {
+    if (objMap->count == 0) {
         return VT_TO_VALUE(VT_NULL);
     }
+    uint32_t index;
+    if (objMap->mode == MAP_MODE_HASH) {
+        uint32_t slot = FindSlot(objMap, key, HashValue(vm, key));
+        if (slot == UINT32_MAX) {
+            return VT_TO_VALUE(VT_NULL);
+        }
+        index = GetIndex(objMap, slot);
+        ClearSlot(objMap, slot);
+    } else {
+        index = FindEntry(vm, objMap, key);
+        if (index == UINT32_MAX) {
+            return VT_TO_VALUE(VT_NULL);
+        }
+    }
 
-    // 设置开放定址的伪删除
-    Value value = entry->value;
-    entry->key = VT_TO_VALUE(VT_UNDEFINED);
-    entry->value = VT_TO_VALUE(VT_TRUE);
+    // 留下空位，保持其余key的顺序和迭代器位置不变
+    Value value = objMap->values == NULL ? VT_TO_VALUE(VT_TRUE) : objMap->values[index];
+    if (objMap->mode == MAP_MODE_ARRAY) {
+        objMap->values[index] = VT_TO_VALUE(VT_UNDEFINED);
+        // 末尾的空位直接去掉，之后还能按下标追加
+        while (objMap->entryCount > 0 && VALUE_IS_UNDEFINED(objMap->values[objMap->entryCount - 1])) {
+            objMap->entryCount--;
+        }
+    } else {
+        objMap->keys[index] = VT_TO_VALUE(VT_UNDEFINED);
+        if (objMap->values != NULL) {
+            objMap->values[index] = VT_TO_VALUE(VT_NULL);
+        }
+    }
+    objMap->count--;
 
-    objMap->count --;
     if (objMap->count == 0) {
         ClearMap(vm, objMap);
-    }
-    else if (objMap->count < objMap->capacity / (CAPACITY_GROW_FACTOR) * MAP_LOAD_PERCENT && objMap->count > MIN_CAPACITY)
-    {
-        uint32_t newCapacity = objMap->capacity / CAPACITY_GROW_FACTOR;
-        if (newCapacity < MIN_CAPACITY)
-        {
-            newCapacity = MIN_CAPACITY;
+    } else if (objMap->mode == MAP_MODE_ARRAY) {
+        // 空位过半就不再适合按数组存放
+        if (objMap->count < objMap->entryCount / 2) {
+            RebuildMap(vm, objMap, objMap->count <= MAP_SMALL_MAX ? MAP_MODE_SMALL : MAP_MODE_HASH,
+                objMap->count <= MAP_SMALL_MAX ? MAP_SMALL_MAX : HashCapacityFor(objMap->count));
+        }
+    } else if (objMap->mode == MAP_MODE_HASH) {
+        if (objMap->count <= MAP_SMALL_MAX / 2) {
+            RebuildMap(vm, objMap, MAP_MODE_SMALL, MAP_SMALL_MAX);
+        } else if (objMap->capacity > MAP_MIN_CAPACITY &&
+            objMap->count < MAP_MAX_LOAD(objMap->capacity) / MAP_SHRINK_DIVISOR) {
+            // 缩到装载约为上限的1/4到1/2，再增加一倍的key才会扩容，不会删了又加时反复缩容扩容
+            RebuildMap(vm, objMap, MAP_MODE_HASH, HashCapacityFor(objMap->count * 2));
+        } else if (objMap->entryCount - objMap->count > objMap->count) {
+            // 删除留下的空位多于在用的key时按原容量重建，清掉墓碑，
+            // 探测不必一直越过它们，迭代也只与在用的key数成正比
+            RebuildMap(vm, objMap, MAP_MODE_HASH, objMap->capacity);
         }
-        ResizeMap(vm, objMap, newCapacity);
     }
     return value;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 复制集合src，存储块整体拷贝，哈希表和顺序原样保留，不必重新散列
+*/
+static ObjMap* CopySet(VM *vm, ObjMap *src)
+{
+    ObjMap *copy = NewObjSet(vm);
+    void *srcStorage = StorageOf(src);
+    if (srcStorage == NULL) {
+        return copy;
+    }
+    uint32_t size = MapStorageSize(src);
+    uint8_t *storage = (uint8_t *)MemManager(vm, NULL, 0, size);
+    memcpy(storage, srcStorage, size);
+    // 各部分在块内的偏移不变
+    ptrdiff_t offset = storage - (uint8_t *)srcStorage;
+    copy->mode = src->mode;
+    copy->count = src->count;
+    copy->capacity = src->capacity;
+    copy->entryCount = src->entryCount;
+    copy->entryCapacity = src->entryCapacity;
+    copy->keys = src->keys == NULL ? NULL : (Value *)((uint8_t *)src->keys + offset);
+    copy->values = src->values == NULL ? NULL : (Value *)((uint8_t *)src->values + offset);
+    copy->indices = src->indices == NULL ? NULL : (uint8_t *)src->indices + offset;
+    copy->ctrl = src->ctrl == NULL ? NULL : src->ctrl + offset;
+    return copy;
+}
+
+/**
+ * @brief 集合a和b的并集，a的元素在前，其后是b中a没有的元素
+*/
+ObjMap* SetUnion(VM *vm, ObjMap *a, ObjMap *b)
+{
+    ObjMap *result = CopySet(vm, a);
+    uint32_t idx = 0;
+    while (idx < b->entryCount) {
+        if (MAP_ENTRY_IS_LIVE(b, idx)) {
+            // 集合中的字符串已驻留，不必再查字符串表
+            Value key = MAP_ENTRY_KEY(b, idx);
+            if (FindEntry(vm, result, key) == UINT32_MAX) {
+                AddEntry(vm, result, key, VT_TO_VALUE(VT_TRUE));
+            }
+        }
+        idx++;
+    }
+    return result;
+}
+
+/**
+ * @brief 集合a和b的交集，遍历较小的集合到较大的中查找，元素顺序同较小的集合
+*/
+ObjMap* SetIntersect(VM *vm, ObjMap *a, ObjMap *b)
+{
+    ObjMap *smaller = a->count <= b->count ? a : b;
+    ObjMap *larger = smaller == a ? b : a;
+    ObjMap *result = NewObjSet(vm);
+    if (larger->count == 0) {
+        return result;
+    }
+    uint32_t idx = 0;
+    while (idx < smaller->entryCount) {
+        if (MAP_ENTRY_IS_LIVE(smaller, idx)) {
+            Value key = MAP_ENTRY_KEY(smaller, idx);
+            if (FindEntry(vm, larger, key) != UINT32_MAX) {
+                AddEntry(vm, result, key, VT_TO_VALUE(VT_TRUE));
+            }
+        }
+        idx++;
+    }
+    return result;
+}
+
+/**
+ * @brief 集合a中不在b中的元素，顺序同a
+ *          b远小于a时复制a再逐个删除b的元素，否则遍历a逐个查找
+*/
+ObjMap* SetDifference(VM *vm, ObjMap *a, ObjMap *b)
+{
+    uint32_t idx = 0;
+    ObjMap *result;
+    if (b->count <= a->count / 2) {
+        result = CopySet(vm, a);
+        while (idx < b->entryCount && result->count > 0) {
+            if (MAP_ENTRY_IS_LIVE(b, idx)) {
+                RemoveKey(vm, result, MAP_ENTRY_KEY(b, idx));
+            }
+            idx++;
+        }
+        return result;
+    }
+    result = NewObjSet(vm);
+    while (idx < a->entryCount) {
+        if (MAP_ENTRY_IS_LIVE(a, idx)) {
+            Value key = MAP_ENTRY_KEY(a, idx);
+            if (FindEntry(vm, b, key) == UINT32_MAX) {
+                AddEntry(vm, result, key, VT_TO_VALUE(VT_TRUE));
+            }
+        }
+        idx++;
+    }
+    return result;
+}
@@ -8,25 +8,68 @@
 
 #include "header_obj.h"
 
-#define MAP_LOAD_PERCENT 0.8
+// key和value按插入顺序稠密地存放在keys和values中，哈希表只存它们的下标
+// 哈希表是swiss table:每个槽位对应1字节控制字节，探测时一次比较一组(16个)控制字节
+// 控制字节最高位为0表示槽位在用，低7位是key哈希值的低7位(h2)，用于过滤
+#define MAP_GROUP_WIDTH 16
+#define MAP_CTRL_EMPTY ((uint8_t)0x80) // 空槽位，探测到此为止
+#define MAP_CTRL_DELETED ((uint8_t)0xFE) // 删除留下的墓碑，探测须越过
+#define MAP_MIN_CAPACITY MAP_GROUP_WIDTH // 容量恒为2的幂，且不小于一组
 
-typedef struct {
-    Value key;
-    Value value;
-} Entry; // key value对儿
+// 装载上限为容量的7/8，keys和values也只分配这么多
+#define MAP_MAX_LOAD(capacity) ((capacity) - (capacity) / 8)
+// 在用的key少于装载上限的1/8时缩容，缩容和扩容后都约占上限的1/4到1/2，两者之间留有余地
+#define MAP_SHRINK_DIVISOR 8
+
+// 槽位中下标的宽度按容量取8、16或32位，下标小于MAP_MAX_LOAD(capacity)
+#define MAP_INDEX8_MAX_CAPACITY 256
+#define MAP_INDEX16_MAX_CAPACITY 65536
+
+#define MAP_SMALL_MAX 8 // 不超过此数的key不建哈希表，逐个比较
+#define MAP_SMALL_MIN_CAPACITY 4
+#define MAP_ARRAY_MIN_CAPACITY 8
+
+typedef enum {
+    MAP_MODE_SMALL, // 只有keys和values，查找时逐个比较，空map也是此模式
+    MAP_MODE_ARRAY, // key依次为0、1、2...，只存values，key即下标
+    MAP_MODE_HASH // keys和values之外还有哈希表
+} MapMode;
+
+// 集合(OT_SET)也用ObjMap存放，只有key没有values，元素对应的value视为true
+// 数组模式下没有keys，集合的values中存true标记在用
+#define MAP_IS_SET(objMap) (OBJ_TYPE(objMap) == OT_SET)
+
+// 第idx个位置是否在用，删除的key(数组模式下是value)置为VT_UNDEFINED，在重建时才被挤掉
+#define MAP_ENTRY_IS_LIVE(objMap, idx) ((objMap)->mode == MAP_MODE_ARRAY ? \
+    !VALUE_IS_UNDEFINED((objMap)->values[idx]) : !VALUE_IS_UNDEFINED((objMap)->keys[idx]))
+// 第idx个位置的key，数组模式下即是idx
+#define MAP_ENTRY_KEY(objMap, idx) ((objMap)->mode == MAP_MODE_ARRAY ? \
+    NUM_TO_VALUE((double)(idx)) : (objMap)->keys[idx])
 
 typedef struct {
     ObjHeader objHeader;
-    uint32_t count;
-    uint32_t capacity; // map的容量
-    Entry *entries; // Entry数组
+    uint8_t mode; // MapMode，随key的个数和形态自动切换
+    uint32_t count; // 在用的key数
+    uint32_t capacity; // 哈希表槽位数，非哈希模式为0
+    uint32_t entryCount; // keys和values中已用的位置数，含删除留下的空位
+    uint32_t entryCapacity; // keys和values能容纳的个数
+    Value *keys; // keys、values、indices和ctrl在同一块内存中，依次排列，数组模式下keys为NULL
+    Value *values; // 集合在数组模式之外为NULL
+    void *indices; // 每个在用槽位中key在keys中的下标
+    uint8_t *ctrl; // capacity + MAP_GROUP_WIDTH - 1个控制字节，末尾的是开头的镜像，使一组可以越过末尾读取
 } ObjMap;
 
 ObjMap* NewObjMap(VM *vm);
+ObjMap* NewObjSet(VM *vm);
 
 void MapSet(VM *vm, ObjMap *objMap, Value key, Value value);
-Value MapGet(ObjMap *objMap, Value key);
+Value MapGet(VM *vm, ObjMap *objMap, Value key);
 void ClearMap(VM *vm, ObjMap *objMap);
 Value RemoveKey(VM *vm, ObjMap *objMap, Value key);
+uint32_t MapStorageSize(ObjMap *objMap);
+
+ObjMap* SetUnion(VM *vm, ObjMap *a, ObjMap *b);
+ObjMap* SetIntersect(VM *vm, ObjMap *a, ObjMap *b);
+ObjMap* SetDifference(VM *vm, ObjMap *a, ObjMap *b);
 
-#endif
\ No newline at end of file
+#endif
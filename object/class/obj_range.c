@@ -10,7 +10,7 @@
 */
 ObjRange* NewObjRange(VM *vm, int from, int to)
 {
-    ObjRange *objRange = ALLOCATE(vm, ObjRange);
+    ObjRange *objRange = ALLOCATE_OBJ(vm, ObjRange);
     InitObjHeader(vm, &objRange->objHeader, OT_RANGE, vm->rangeClass);
     objRange->from = from;
     objRange->to = to;
@@ -8,28 +8,57 @@
 #include "common.h"
 #include "utils.h"
 #include "vm.h"
+#include "class.h"
+#include "unicode.h"
+#include "hash.h"
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
+// 切片的length要与ObjString的value.length重合，两者才能按ObjString统一读取
+_Static_assert(offsetof(ObjStringSlice, length) == offsetof(ObjString, value.length),
+    "ObjStringSlice must share the ObjString prefix");
+
 /**
- * @brief fnv-la算法
+ * @brief 以seed为种子计算字符串的哈希码，结果不为STRING_HASH_UNSET
 */
-uint32_t HashString(char *str, uint32_t length)
+uint32_t HashString(uint64_t seed, const char *str, uint32_t length)
 {
-    uint32_t hashCode = 2166136261, idx = 0;
-    while (idx < length) {
-        hashCode ^= str[idx];
-        hashCode *= 16777619;
-        idx ++;
+    uint64_t hash = HashBytes(str, length, seed);
+    uint32_t hashCode = (uint32_t)(hash ^ (hash >> 32));
+    return hashCode == STRING_HASH_UNSET ? 1 : hashCode;
+}
+
+/**
+ * @brief 返回string的哈希码，首次使用时才计算并存入string->hashCode
+ *          多数字符串(如拼接的中间结果)从不作为key，不必在创建时就计算
+*/
+uint32_t HashObjString(VM *vm, ObjString *objString)
+{
+    if (objString->hashCode == STRING_HASH_UNSET) {
+        objString->hashCode = HashString(vm->hashSeed, STRING_START(objString), objString->value.length);
     }
-    return hashCode;
+    return objString->hashCode;
 }
 
 /**
- * @brief 为string计算哈希码并将值存储到string->hash
+ * @brief 分配能容纳length个字符的ObjString，内容由调用者填写
 */
-void HashObjString(ObjString *objString)
+ObjString* AllocateObjString(VM *vm, uint32_t length)
 {
-    objString->hashCode = HashString(objString->value.start, objString->value.length);
+    // ALLOCATE_EXTRA用于柔性数组的分配
+    ObjString *objString = ALLOCATE_OBJ_EXTRA(vm, ObjString, length + 1);
+    if (objString == NULL) {
+        MEM_ERROR("Allocating ObjString failed!");
+    }
+    // stringClass为meta类
+    InitObjHeader(vm, &objString->objHeader, OT_STRING, vm->stringClass);
+    objString->hashCode = STRING_HASH_UNSET;
+    objString->isSlice = false;
+    objString->isAscii = false; // 由填写内容的调用者设置
+    objString->value.length = length;
+    objString->value.start[length] = '\0'; // 最后一个，即length + 1长度的1
+    return objString;
 }
 
 /**
@@ -39,22 +68,262 @@ ObjString* NewObjString(VM *vm, const char *str, uint32_t length)
 {
     ASSERT(length == 0 || str != NULL, "Str length don't match str!");
 
-    // ALLOCATE_EXTRA用于柔性数组的分配
-    ObjString *objString = ALLOCATE_EXTRA(vm, ObjString, length + 1);
+    // 空串和单字节串共用预先创建的对象，不再分配
+    if (length <= 1) {
+        ObjString *small = vm->smallStrings[length == 0 ? SMALL_STRING_EMPTY : (uint8_t)str[0]];
+        if (small != NULL) {
+            return small;
+        }
+    }
 
-    if (objString != NULL) {
-        // stringClass为meta类
-        InitObjHeader(vm, &objString->objHeader, OT_STRING, vm->stringClass);
-        objString->value.length = length;
+    ObjString *objString = AllocateObjString(vm, length);
+    // 支持空字符串:str为null，length为0
+    if (length > 0) {
+        memcpy(objString->value.start, str, length);
+    }
+    objString->isAscii = IsAsciiBuffer((const uint8_t *)str, length);
+    return objString;
+}
 
-        // 支持空字符串:str为null，length为0
-        if (length > 0) {
-            memcpy(objString->value.start, str, length);
+/**
+ * @brief 预先创建空串和全部256个单字节串，它们作为根常驻不回收
+ *          取单个字符、逐字符迭代等产生的短串都直接取用，不必分配
+*/
+void InitSmallStrings(VM *vm)
+{
+    uint32_t idx = 0;
+    while (idx < SMALL_STRING_NUM) {
+        vm->smallStrings[idx] = NULL;
+        idx++;
+    }
+    idx = 0;
+    while (idx < SMALL_STRING_NUM) {
+        uint32_t length = idx == SMALL_STRING_EMPTY ? 0 : 1;
+        ObjString *objString = AllocateObjString(vm, length);
+        if (length == 1) {
+            objString->value.start[0] = (char)idx;
         }
-        objString->value.start[length] = '\0'; // 最后一个，即length + 1长度的1
-        HashObjString(objString); // 获得该字符串的哈希码
-    } else {
+        objString->isAscii = idx < 0x80 || idx == SMALL_STRING_EMPTY;
+        vm->smallStrings[idx] = objString;
+        idx++;
+    }
+}
+
+/**
+ * @brief 创建source中从offset起length个字节的子串
+ *          足够长时创建引用父串的切片而不复制，过短或父串太大时仍复制
+*/
+ObjString* NewStringSlice(VM *vm, ObjString *source, uint32_t offset, uint32_t length)
+{
+    ASSERT(offset + length <= source->value.length, "slice out of bound!");
+
+    // 字符串不可变，整串直接复用
+    if (offset == 0 && length == source->value.length) {
+        return source;
+    }
+    // 切片的切片直接引用最初的父串，不形成链
+    // 父串自身不是切片，具体化之后的切片也不作父串，它的子串直接复制
+    ObjString *parent = STRING_IS_SLICE(source) ? STRING_AS_SLICE(source)->parent : source;
+    const char *start = STRING_START(source) + offset;
+    if (length < STRING_SLICE_MIN_LENGTH || parent->value.length / STRING_SLICE_MAX_RATIO > length ||
+        parent->isSlice) {
+        return NewObjString(vm, start, length);
+    }
+
+    ObjStringSlice *slice = ALLOCATE_OBJ(vm, ObjStringSlice);
+    if (slice == NULL) {
         MEM_ERROR("Allocating ObjString failed!");
     }
+    InitObjHeader(vm, &slice->objHeader, OT_STRING, vm->stringClass);
+    slice->isSlice = true;
+    slice->parent = parent;
+    slice->start = (char *)start;
+    slice->length = length;
+    slice->isAscii = source->isAscii || IsAsciiBuffer((const uint8_t *)start, length);
+    slice->hashCode = STRING_HASH_UNSET;
+    return (ObjString *)slice;
+}
+
+/**
+ * @brief 把切片的内容复制到单独的缓冲区，不再引用父串
+ *          需要以\0结尾的c字符串或字符串要长期保存(如作为map的key)时调用
+*/
+void MaterializeString(VM *vm, ObjString *objString)
+{
+    if (!STRING_IS_SLICE(objString)) {
+        return;
+    }
+    ObjStringSlice *slice = STRING_AS_SLICE(objString);
+    char *buf = ALLOCATE_ARRAY(vm, char, slice->length + 1);
+    memcpy(buf, slice->start, slice->length);
+    buf[slice->length] = '\0';
+    slice->start = buf;
+    slice->parent = NULL;
+}
+
+/**
+ * @brief 初始化字符串驻留表
+*/
+void InitStringTable(StringTable *table)
+{
+    table->strings = NULL;
+    table->capacity = table->count = table->tombstoneNum = 0;
+}
+
+/**
+ * @brief 释放驻留表本身，其中的字符串由GC负责回收
+*/
+void FreeStringTable(StringTable *table)
+{
+    free(table->strings);
+    InitStringTable(table);
+}
+
+/**
+ * @brief 在驻留表中查找内容为str的字符串，没有则返回NULL
+*/
+static ObjString* FindInterned(StringTable *table, const char *str, uint32_t length, uint32_t hashCode)
+{
+    if (table->capacity == 0) {
+        return NULL;
+    }
+    uint32_t mask = table->capacity - 1;
+    uint32_t index = hashCode & mask;
+    ObjString *objString;
+    // 墓碑之后可能还有探测链上的字符串，到空位才停止
+    while ((objString = table->strings[index]) != NULL) {
+        if (objString != STRING_TABLE_TOMBSTONE &&
+            objString->hashCode == hashCode && objString->value.length == length &&
+            memcmp(STRING_START(objString), str, length) == 0) {
+            return objString;
+        }
+        index = (index + 1) & mask;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 把objString放入strings的第一个空位或墓碑，返回所用位置原先是否为墓碑
+ *          调用者保证表中尚无相同内容的字符串
+*/
+static boolean InsertInterned(ObjString **strings, uint32_t capacity, ObjString *objString)
+{
+    uint32_t mask = capacity - 1;
+    uint32_t index = objString->hashCode & mask;
+    while (STRING_TABLE_ENTRY_IS_LIVE(strings[index])) {
+        index = (index + 1) & mask;
+    }
+    boolean isTombstone = strings[index] == STRING_TABLE_TOMBSTONE;
+    strings[index] = objString;
+    return isTombstone;
+}
+
+/**
+ * @brief 把驻留表的容量调整为newCapacity，旧表中在用的字符串重新定位，墓碑随之清除
+*/
+static void ResizeStringTable(StringTable *table, uint32_t newCapacity)
+{
+    // 和grays一样直接用calloc，GC清扫期间也会调整容量，不计入allocatedBytes
+    ObjString **newStrings = (ObjString **)calloc(newCapacity, sizeof(ObjString *));
+    if (newStrings == NULL) {
+        MEM_ERROR("Allocating string table failed!");
+    }
+    uint32_t idx = 0;
+    while (idx < table->capacity) {
+        if (STRING_TABLE_ENTRY_IS_LIVE(table->strings[idx])) {
+            InsertInterned(newStrings, newCapacity, table->strings[idx]);
+        }
+        idx ++;
+    }
+    free(table->strings);
+    table->strings = newStrings;
+    table->capacity = newCapacity;
+    table->tombstoneNum = 0;
+}
+
+/**
+ * @brief 容纳count个字符串且装载不超过上限一半的最小容量，重建后要再增加一倍才需重建
+*/
+static uint32_t StringTableCapacityFor(uint32_t count)
+{
+    uint32_t capacity = STRING_TABLE_MIN_CAPACITY;
+    while (count > capacity * STRING_TABLE_LOAD_PERCENT / 2) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/**
+ * @brief 把objString加入驻留表
+ *          在用和墓碑的位置合计超过装载上限时按在用数重建，墓碑多时容量不变，只清除墓碑
+*/
+static void AddInterned(StringTable *table, ObjString *objString)
+{
+    if (table->count + table->tombstoneNum + 1 > table->capacity * STRING_TABLE_LOAD_PERCENT) {
+        ResizeStringTable(table, StringTableCapacityFor(table->count + 1));
+    }
+    if (InsertInterned(table->strings, table->capacity, objString)) {
+        table->tombstoneNum --;
+    }
+    table->count ++;
+}
+
+/**
+ * @brief 返回内容为str的驻留字符串，已有则复用，没有则新建并驻留
+ *          同一内容的驻留字符串只有一个，可直接用指针判等
+*/
+ObjString* InternString(VM *vm, const char *str, uint32_t length)
+{
+    uint32_t hashCode = HashString(vm->hashSeed, str, length);
+    ObjString *objString = FindInterned(&vm->strings, str, length, hashCode);
+    if (objString != NULL) {
+        return objString;
+    }
+    objString = NewObjString(vm, str, length);
+    objString->hashCode = hashCode;
+    AddInterned(&vm->strings, objString);
     return objString;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 若value是字符串则返回其驻留版本，已有相同内容的驻留字符串时返回已有的，
+ *          否则把value本身驻留；其他类型原样返回
+*/
+Value InternValue(VM *vm, Value value)
+{
+    if (!VALUE_IS_OBJSTR(value)) {
+        return value;
+    }
+    ObjString *objString = (ObjString *)value.objHeader;
+    ObjString *interned = FindInterned(&vm->strings, STRING_START(objString), objString->value.length,
+        HashObjString(vm, objString));
+    if (interned != NULL) {
+        return OBJ_TO_VALUE(interned);
+    }
+    // 驻留的字符串会长期存活，不能留住切片的父串
+    MaterializeString(vm, objString);
+    AddInterned(&vm->strings, objString);
+    return value;
+}
+
+/**
+ * @brief 标记结束后、清扫之前调用，把未被标记的字符串换成墓碑
+ *          只在表变得稀疏时才重建缩容，否则不分配也不重新定位
+*/
+void SweepStringTable(StringTable *table)
+{
+    uint32_t idx = 0;
+    while (idx < table->capacity) {
+        ObjString *objString = table->strings[idx];
+        if (STRING_TABLE_ENTRY_IS_LIVE(objString) && !HeapIsMarked(objString)) {
+            table->strings[idx] = STRING_TABLE_TOMBSTONE;
+            table->count --;
+            table->tombstoneNum ++;
+        }
+        idx ++;
+    }
+    if (table->capacity > STRING_TABLE_MIN_CAPACITY &&
+        table->count < table->capacity * STRING_TABLE_LOAD_PERCENT / STRING_TABLE_SHRINK_DIVISOR) {
+        ResizeStringTable(table, StringTableCapacityFor(table->count));
+    }
+}
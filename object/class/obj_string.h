@@ -8,18 +8,74 @@
 
 #include "header_obj.h"
 
-typedef struct {
+typedef struct objString {
     ObjHeader objHeader;
-    uint32_t hashCode;// 字符从哈希值
+    uint32_t hashCode;// 字符从哈希值，首次用到时才计算，之前为STRING_HASH_UNSET
+    boolean isAscii; // 内容全是ASCII，一个字节就是一个字符，不必按UTF-8解码
+    boolean isSlice; // 内容不在对象之内，对象实际是ObjStringSlice
     // typedef struct {
     //     uint32_t length; // 除结束\0之外的字符个数
     //     char start[0]; // 类似c99中的柔性数组
     // } CharValue; // 字符串缓冲区
+    // 一般字符串的内容紧跟在对象之后，以\0结尾；切片的value.start无效，内容须用STRING_START取
     CharValue value;
 } ObjString;
 
-uint32_t HashString(char *str, uint32_t length);
-void HashObjString(ObjString *objString);
+// 切片，开头的字段与ObjString相同，只有切片多占parent和start两个指针
+// start有两种指向:
+// 1 父串parent中的某处，不以\0结尾，不复制字符
+// 2 单独分配的缓冲区，具体化(MaterializeString)之后，以\0结尾，parent为NULL
+typedef struct {
+    ObjHeader objHeader;
+    uint32_t hashCode;
+    boolean isAscii;
+    boolean isSlice; // 恒为true
+    uint32_t length; // 与ObjString的value.length位置相同
+    struct objString *parent; // 引用的父串，父串自身不是切片
+    char *start;
+} ObjStringSlice;
+
+#define STRING_AS_SLICE(objString) ((ObjStringSlice *)(objString))
+// 字符串内容的起始地址，一般字符串和切片都适用
+#define STRING_START(objString) \
+    ((objString)->isSlice ? STRING_AS_SLICE(objString)->start : (objString)->value.start)
+
+#define STRING_HASH_UNSET 0 // hashCode尚未计算，计算出的哈希码不会是此值
+#define STRING_SLICE_MIN_LENGTH 32 // 短于此长度的子串直接复制，切片省下的不如对象头多
+#define STRING_SLICE_MAX_RATIO 16 // 父串长度超过子串此倍数时复制，免得小切片留住大父串
+
+// 是否是引用父串的切片，这样的字符串内容不以\0结尾
+#define STRING_IS_SLICE(objString) ((objString)->isSlice && STRING_AS_SLICE(objString)->parent != NULL)
+
+#define SMALL_STRING_EMPTY 256 // vm->smallStrings中空串的下标，之前的0~255是单字节串
+#define SMALL_STRING_NUM 257
+
+#define STRING_TABLE_MIN_CAPACITY 64 // 驻留表的最小容量，容量恒为2的幂
+#define STRING_TABLE_LOAD_PERCENT 0.75 // 驻留表的装载因子上限，在用和墓碑的位置合计不超过此比例
+#define STRING_TABLE_SHRINK_DIVISOR 8 // 在用的少于上限的1/8时缩容
+// 被回收的字符串留下的墓碑，查找时越过，插入时可复用
+#define STRING_TABLE_TOMBSTONE ((ObjString *)1)
+#define STRING_TABLE_ENTRY_IS_LIVE(objString) \
+    ((objString) != NULL && (objString) != STRING_TABLE_TOMBSTONE)
+
+typedef struct {
+    ObjString **strings; // 开放定址表，以hashCode定位，NULL为空位
+    uint32_t capacity;
+    uint32_t count; // 在用的位置数
+    uint32_t tombstoneNum; // 墓碑数
+} StringTable; // 字符串驻留表，弱引用其中的字符串，不阻止其被回收
+
+uint32_t HashString(uint64_t seed, const char *str, uint32_t length);
+uint32_t HashObjString(VM *vm, ObjString *objString);
+ObjString* AllocateObjString(VM *vm, uint32_t length);
 ObjString* NewObjString(VM *vm, const char *str, uint32_t length);
+ObjString* NewStringSlice(VM *vm, ObjString *source, uint32_t offset, uint32_t length);
+void MaterializeString(VM *vm, ObjString *objString);
+void InitSmallStrings(VM *vm);
+void InitStringTable(StringTable *table);
+void FreeStringTable(StringTable *table);
+ObjString* InternString(VM *vm, const char *str, uint32_t length);
+Value InternValue(VM *vm, Value value);
+void SweepStringTable(StringTable *table);
 
 #endif
\ No newline at end of file
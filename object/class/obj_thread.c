@@ -33,7 +33,7 @@ ObjThread* NewObjThread(VM *vm, ObjClosure *objClosure)
     uint32_t stackCapacity = CeilToPowerOf2(objClosure->fn->maxStackSlotUsedNum + 1);
     Value *newStack = ALLOCATE_ARRAY(vm, Value, stackCapacity);
 
-    ObjThread *objThread = ALLOCATE(vm, ObjThread);
+    ObjThread *objThread = ALLOCATE_OBJ(vm, ObjThread);
     InitObjHeader(vm, &objThread->objHeader, OT_THREAD, vm->threadClass);
 
     objThread->frames = frames;
@@ -53,6 +53,7 @@ void ResetThread(ObjThread *objThread, ObjClosure *objClosure)
     objThread->esp = objThread->stack;
     objThread->openUpvalues = NULL;
     objThread->caller = NULL;
+    objThread->isTry = false;
     objThread->errorObj = VT_TO_VALUE(VT_NULL);
     objThread->usedFrameNum = 0;
 
@@ -24,6 +24,7 @@ typedef struct ObjThread {
 
     ObjUpvalue *openUpvalues; // upvalue的链表首节点
     struct ObjThread *caller; // 当前thread的调用者
+    boolean isTry; // 是否由try调用，是则出错时错误作为try的结果交给调用者，不再向上传播
 
     Value errorObj; // 
 } ObjThread; // 线程对象
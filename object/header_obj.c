@@ -12,14 +12,8 @@ DEFINE_BUFFER_METHOD(Value)
 /**
  * @brief 初始化对象头
 */
-void InitObjHeader(VM *vm, ObjHeader *objHeader, ObjType objType, Class *class)
+void InitObjHeader(VM *vm UNUSED, ObjHeader *objHeader, ObjType objType, Class *class)
 {
-    objHeader->type = objType;
-    // 与GC相关
-    objHeader->isdark = false;
-
-    objHeader->class = class;  // 设置meta类
-    
-    objHeader->next = vm->allObjects;  // 设新对象头放在链表头
-    vm->allObjects = objHeader; // 重新指向
+    ASSERT(((uintptr_t)class & OBJ_TYPE_MASK) == 0, "class address must be aligned!");
+    objHeader->classAndType = (uintptr_t)class | (uintptr_t)objType;  // 设置meta类
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 
 #include "utils.h"
 #include "common.h"
+#include "heap.h"
 
 typedef enum {
     OT_CLASS,  
@@ -20,16 +21,25 @@ typedef enum {
     OT_FUNCTION,
     OT_CLOSURE,
     OT_INSTANCE,
-    OT_THREAD
+    OT_THREAD,
+    OT_SET // 集合，与map共用ObjMap结构，只存key
 } ObjType; // 对象类型
 
+#define OBJ_TYPE_MASK ((uintptr_t)0xf) // 对象头中存放ObjType的低4位
+
 typedef struct ObjHeader {
-    ObjType type;
-    boolean isdark; // 对象是否可达
-    Class *class; // 对象所属于的类 元类
-    struct ObjHeader *next; // 用以链接所有已分配对象
+    // 低4位为ObjType，其余位为对象所属的类(元类)的地址
+    // 对象都按HEAP_SLOT_ALIGN对齐，类地址的低4位恒为0
+    // 可达标记在heap.h的标记位图中，所有对象由堆页遍历，不再用链表串起来
+    uintptr_t classAndType;
 } ObjHeader;  // 对象头，用于记录元信息和垃圾回收
 
+#define OBJ_TYPE(objPtr) ((ObjType)(((ObjHeader *)(objPtr))->classAndType & OBJ_TYPE_MASK))
+#define OBJ_CLASS(objPtr) ((Class *)(((ObjHeader *)(objPtr))->classAndType & ~OBJ_TYPE_MASK))
+#define SET_OBJ_CLASS(objPtr, classPtr) \
+    (((ObjHeader *)(objPtr))->classAndType = \
+        (uintptr_t)(classPtr) | (((ObjHeader *)(objPtr))->classAndType & OBJ_TYPE_MASK))
+
 typedef enum { 
     VT_UNDEFINED, VT_NULL, VT_FALSE, VT_TRUE, VT_NUM, VT_OBJ 
 } ValueType;
@@ -7,6 +7,7 @@
 #include "utils.h"
 #include "common.h"
 #include "unicode.h"
+#include "num_parse.h"
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
@@ -191,6 +192,20 @@ static void ParseString(Parser *parser)
     ByteBuffer str;
     ByteBufferInit(&str);
     while (true) {
+        // 引号、%、\和\0之外的字节成段处理，校验UTF-8后整段追加
+        // 多字节字符的各个字节都不小于0x80，不会被这几个ASCII字符截断
+        const char *runEnd = parser->nextCharPtr;
+        while (*runEnd != '"' && *runEnd != '%' && *runEnd != '\\' && *runEnd != '\0') {
+            runEnd ++;
+        }
+        if (runEnd != parser->nextCharPtr) {
+            uint32_t runLength = (uint32_t)(runEnd - parser->nextCharPtr);
+            if (!ValidateUtf8((const uint8_t *)parser->nextCharPtr, runLength)) {
+                LEX_ERROR(parser, "invalid utf-8 sequence in string!");
+            }
+            ByteBufferAppend(parser->vm, &str, (const uint8_t *)parser->nextCharPtr, runLength);
+            parser->nextCharPtr = runEnd;
+        }
         GetNextChar(parser);
         // \0是字符串结束标识，应该在"之后
         if (parser->curChar == '\0') {
@@ -256,7 +271,7 @@ static void ParseString(Parser *parser)
         }
     }
     // 用识别到的字符串新建字符串对象存储到cur_token的value中
-    ObjString *obj_string = NewObjString(parser->vm, (const char *)str.datas, str.count);
+    ObjString *obj_string = InternString(parser->vm, (const char *)str.datas, str.count);
     parser->curToken.value = OBJ_TO_VALUE(obj_string);
     ByteBufferClear(parser->vm, &str);
 }
@@ -317,20 +332,35 @@ static void ParseOctNum(Parser *parser)
 */
 static void ParserNum(Parser *parser)
 {
+    // 先确定数字的范围，再由num_parse.c按长度转换，不经过strtod/strtol
+    uint32_t base = 10;
     if (parser->curChar == '0' && MatchNextChar(parser, 'x')) {
         GetNextChar(parser);
         ParseHexNum(parser);
-        // parser->curToken.value = NUM_TO_VALUE(strtol(parser->curToken.start, NULL, 16));
+        base = 16;
     } else if (parser->curChar == '0' && isdigit(LookAheadChar(parser))) {
         ParseOctNum(parser);
-        // parser->curToken.value = NUM_TO_VALUE(strtol(parser->curToken.start, NULL, 8));
+        base = 8;
     } else {
         ParseDecNum(parser);
-        // parser->curToken.value = NUM_TO_VALUE(strtod(parser->curToken.start, NULL));
     }
     // next_char_ptr会指向第一个不合法字符的下一个字符，因此-1
     parser->curToken.length = (uint32_t)(parser->nextCharPtr - parser->curToken.start - 1);
     parser->curToken.type = TOKEN_NUM;
+
+    double num;
+    if (base == 16) {
+        num = ParseInteger(parser->curToken.start + 2, parser->curToken.length - 2, 16);
+    } else if (base == 8) {
+        num = ParseInteger(parser->curToken.start, parser->curToken.length, 8);
+    } else {
+        boolean overflow;
+        ParseDouble(parser->curToken.start, parser->curToken.length, &num, &overflow);
+        if (overflow) {
+            LEX_ERROR(parser, "number literal %.*s is too large!", parser->curToken.length, parser->curToken.start);
+        }
+    }
+    parser->curToken.value = NUM_TO_VALUE(num);
 }
 
 /**
@@ -9,6 +9,7 @@
 #include "common.h"
 #include "vm.h"
 #include "compile.h"
+#include "arena.h"
 
 typedef enum {
     TOKEN_UNKNOWN, TOKEN_NUM, TOKEN_STRING, TOKEN_ID, TOKEN_INTERPOLATION,
@@ -48,6 +49,7 @@ struct parser {
     int interpolationExpectRightParenNum;
     VM *vm;
     struct parser *parent; // 指向父parser
+    Arena *arena; // 本次编译期间的临时数据都从这里分配，编译结束后整体释放
 };
 
 char LookAheadChar(Parser *parser);
@@ -8,6 +8,10 @@
 #include "core.h"
 #include "compile.h"
 #include "unicode.h"
+#include "str_search.h"
+#include "dtoa.h"
+#include "num_parse.h"
+#include "gc.h"
 #include <string.h>
 #include <sys/stat.h>
 #include <ctype.h>
@@ -146,7 +150,7 @@ static boolean PrimObjectIs(VM *vm, Value *args)
 */
 static boolean PrimObjectToString(VM *vm UNUSED, Value *args)
 {
-    Class *class = args[0].objHeader->class;
+    Class *class = OBJ_CLASS(args[0].objHeader);
     Value nameValue = OBJ_TO_VALUE(class->name);
     RET_VALUE(nameValue);
 }
@@ -273,7 +277,7 @@ void BindSuperClass(VM *vm, Class *subClass, Class *superClass)
 */
 static ObjModule* GetModule(VM *vm, Value moduleName)
 {
-    Value value = MapGet(vm->allModules, moduleName);
+    Value value = MapGet(vm, vm->allModules, moduleName);
     if (value.valueType == VT_UNDEFINED) {
         return NULL;
     }
@@ -303,9 +307,10 @@ static ObjThread* LoadModule(VM *vm, Value moduleName, const char *moduleCode)
    // 避免重复载入
    if (module == NULL) {
       ObjString *modName = VALUE_TO_OBJSTR(moduleName);
-      ASSERT(modName->value.start[modName->value.length] == '\0', "string.value.start is not terminated!");
+      MaterializeString(vm, modName); // 切片不以\0结尾
+      ASSERT(STRING_START(modName)[modName->value.length] == '\0', "string.value.start is not terminated!");
 
-      module = NewObjModule(vm, modName->value.start);
+      module = NewObjModule(vm, STRING_START(modName));
       MapSet(vm, vm->allModules, moduleName, OBJ_TO_VALUE(module));
 
       // 继承核心模块中的变量
@@ -375,10 +380,10 @@ static ObjString* NumToStr(VM* vm, double num) {
       return NewObjString(vm, "-infinity", 9);
    }
 
-  //以下24字节的缓冲区足以容纳双精度到字符串的转换
-  char buf[24] = {'\0'};
-  int len = sprintf(buf, "%.14g", num);
-  return NewObjString(vm, buf, len);
+   //输出能原样解析回num的最短形式,整数直接输出,见dtoa.c
+   char buf[DTOA_BUFFER_SIZE];
+   uint32_t len = FormatDouble(buf, num);
+   return NewObjString(vm, buf, len);
 }
 
 //判断arg是否为数字
@@ -410,25 +415,32 @@ static boolean PrimNumFromString(VM* vm, Value* args) {
       RET_NULL;
    }
 
-   ASSERT(objString->value.start[objString->value.length] == '\0', "objString don`t teminate!");
+   //按长度解析,切片不必以\0结尾,与词法分析共用num_parse.c
+   const char* start = STRING_START(objString);
+   const char* end = start + objString->value.length;
+   //跳过前面的空白
+   while (start < end && isspace((unsigned char)*start)) {
+      start++;
+   }
 
-   errno = 0;
-   char* endPtr;
+   double num;
+   boolean overflow;
+   const char* endPtr = start + ParseDouble(start, (uint32_t)(end - start), &num, &overflow);
+   if (endPtr == start) {
+      RET_NULL;
+   }
 
-   //将字符串转换为double型, 它会自动跳过前面的空白
-   double num = strtod(objString->value.start, &endPtr);
-   
-   //以endPtr是否等于start+length来判断不能转换的字符之后是否全是空白
-   while (*endPtr != '\0' && isspace((unsigned char)*endPtr)) {
+   //不能转换的字符之后须全是空白
+   while (endPtr < end && isspace((unsigned char)*endPtr)) {
       endPtr++;   
    }
    
-   if (errno == ERANGE) {
+   if (overflow) {
       RUNTIME_ERROR("string too large!"); 
    }
 
    //如果字符串中不能转换的字符不全是空白,字符串非法,返回NULL
-   if (endPtr < objString->value.start + objString->value.length) {
+   if (endPtr < end) {
       RET_NULL;   
    }
 
@@ -690,12 +702,13 @@ static boolean PrimThreadYieldWithoutArg(VM* vm, Value* args UNUSED) {
 
 //切换到下一个线程nextThread
 static boolean SwitchThread(VM* vm, 
-      ObjThread* nextThread, Value* args, boolean withArg) {
+      ObjThread* nextThread, Value* args, boolean withArg, boolean isTry) {
    //在下一线程nextThread执行之前,其主调线程应该为空
    if (nextThread->caller != NULL) {
       RUNTIME_ERROR("thread has been called!");
    }
    nextThread->caller = vm->curThread;
+   nextThread->isTry = isTry;
 
    if (nextThread->usedFrameNum == 0) {
       //只有已经运行完毕的thread的usedFrameNum才为0
@@ -727,12 +740,27 @@ static boolean SwitchThread(VM* vm,
 
 //objThread.call()
 static boolean PrimThreadCallWithoutArg(VM* vm, Value* args) {
-   return SwitchThread(vm, VALUE_TO_OBJTHREAD(args[0]), args, false);
+   return SwitchThread(vm, VALUE_TO_OBJTHREAD(args[0]), args, false, false);
 }
 
 //objThread.call(arg)
 static boolean PrimThreadCallWithArg(VM* vm, Value* args) {
-   return SwitchThread(vm, VALUE_TO_OBJTHREAD(args[0]), args, true);
+   return SwitchThread(vm, VALUE_TO_OBJTHREAD(args[0]), args, true, false);
+}
+
+//objThread.try():同call(),线程出错时错误作为结果返回,不再结束调用者
+static boolean PrimThreadTryWithoutArg(VM* vm, Value* args) {
+   return SwitchThread(vm, VALUE_TO_OBJTHREAD(args[0]), args, false, true);
+}
+
+//objThread.try(arg)
+static boolean PrimThreadTryWithArg(VM* vm, Value* args) {
+   return SwitchThread(vm, VALUE_TO_OBJTHREAD(args[0]), args, true, true);
+}
+
+//objThread.error返回线程出错结束时的错误,没有出错为null
+static boolean PrimThreadError(VM* vm UNUSED, Value* args) {
+   RET_VALUE(VALUE_TO_OBJTHREAD(args[0])->errorObj);
 }
 
 //objThread.isDone返回线程是否运行完成
@@ -797,31 +825,31 @@ static uint32_t ValidateIndex(VM* vm, Value index, uint32_t length) {
 static Value MakeStringFromCodePoint(VM* vm, int value) {
    uint32_t byteNum = GetByteNumOfEncodeUtf8(value);
    ASSERT(byteNum != 0, "utf8 encode bytes should be between 1 and 4!");
-
-   //+1是为了结尾的'\0'
-   ObjString* objString = ALLOCATE_EXTRA(vm, ObjString, byteNum + 1);
-
-   if (objString == NULL) {
-      MEM_ERROR("allocate memory failed in runtime!"); 
+   //ASCII字符取常驻的单字节串
+   if (byteNum == 1) {
+      ObjString* small = vm->smallStrings[value];
+      return OBJ_TO_VALUE(small);
    }
 
-   InitObjHeader(vm, &objString->objHeader, OT_STRING, vm->stringClass);
-   objString->value.length = byteNum;
-   objString->value.start[byteNum] = '\0';
+   ObjString* objString = AllocateObjString(vm, byteNum);
+   objString->isAscii = false;
    EncodeUtf8((uint8_t*)objString->value.start, value);
-   HashObjString(objString);
    return OBJ_TO_VALUE(objString);
 }
 
 //用索引index处的字符创建字符串对象
 static Value StringCodePointAt(VM* vm, ObjString* objString, uint32_t index) {
    ASSERT(index < objString->value.length, "index out of bound!");  
-   int codePoint = DecodeUtf8((uint8_t*)objString->value.start + index,
+   //ASCII串中每个字节就是一个字符,取常驻的单字节串
+   if (objString->isAscii) {
+      return OBJ_TO_VALUE(vm->smallStrings[(uint8_t)STRING_START(objString)[index]]);
+   }
+   int codePoint = DecodeUtf8((uint8_t*)STRING_START(objString) + index,
 	 objString->value.length - index);
 
    //若不是有效的utf8序列,将其处理为单个裸字符
    if (codePoint == -1) {
-      return OBJ_TO_VALUE(NewObjString(vm, &objString->value.start[index], 1));
+      return OBJ_TO_VALUE(vm->smallStrings[(uint8_t)STRING_START(objString)[index]]);
    }
 
    return MakeStringFromCodePoint(vm, codePoint);
@@ -851,7 +879,19 @@ static uint32_t CalculateRange(VM* vm,
 static ObjString* NewObjStringFromSub(VM* vm, ObjString* sourceStr,
       int startIndex, uint32_t count, int direction) {
 
-   uint8_t* source = (uint8_t*)sourceStr->value.start;
+   //正向截取的是源串中连续的一段,不必逐个字符解码再编码,足够长时还不复制
+   //ASCII串的字节即字符,下标就是边界
+   if (direction == 1 && sourceStr->isAscii) {
+      return NewStringSlice(vm, sourceStr, startIndex, count);
+   }
+   uint32_t spanStart, spanEnd;
+   if (direction == 1 &&
+         FindUtf8Span((uint8_t*)STRING_START(sourceStr), sourceStr->value.length,
+            startIndex, count, &spanStart, &spanEnd)) {
+      return NewStringSlice(vm, sourceStr, spanStart, spanEnd - spanStart);
+   }
+
+   uint8_t* source = (uint8_t*)STRING_START(sourceStr);
    uint32_t totalLength = 0, idx = 0;
 
    //计算count个utf8编码的字符总共需要的字节数,后面好申请空间
@@ -860,15 +900,7 @@ static ObjString* NewObjStringFromSub(VM* vm, ObjString* sourceStr,
       idx++;
    }
 
-   //+1是为了结尾的'\0'
-   ObjString* result = ALLOCATE_EXTRA(vm, ObjString, totalLength + 1);
-
-   if (result == NULL) {
-      MEM_ERROR("allocate memory failed in runtime!"); 
-   }
-   InitObjHeader(vm, &result->objHeader, OT_STRING, vm->stringClass);
-   result->value.start[totalLength] = '\0';
-   result->value.length = totalLength;
+   ObjString* result = AllocateObjString(vm, totalLength);
 
    uint8_t* dest = (uint8_t*)result->value.start;
    idx = 0; 
@@ -883,75 +915,15 @@ static ObjString* NewObjStringFromSub(VM* vm, ObjString* sourceStr,
       idx++;
    }
 
-   HashObjString(result);
+   result->isAscii = sourceStr->isAscii || IsAsciiBuffer((uint8_t*)result->value.start, totalLength);
    return result;
 }
 
-//使用Boyer-Moore-Horspool字符串匹配算法在haystack中查找needle,大海捞针
+//在haystack中查找needle,大海捞针
+//短needle用SIMD按首尾字节过滤,长needle用two-way算法,见str_search.c
 static int FindString(ObjString* haystack, ObjString* needle) {
-   //如果待查找的patten为空则为找到
-   if (needle->value.length == 0) {
-      return 0;    //返回起始下标0
-   }
-
-   //若待搜索的字符串比原串还长 肯定搜不到
-   if (needle->value.length > haystack->value.length) {
-      return -1; 
-   }
-
-   //构建"bad-character shift表"以确定窗口滑动的距离
-   //数组shift的值便是滑动距离
-   uint32_t shift[UINT8_MAX];
-   //needle中最后一个字符的下标
-   uint32_t needleEnd = needle->value.length - 1;
-
-   //一、 先假定"bad character"不属于needle(即pattern),
-   //对于这种情况,滑动窗口跨过整个needle 
-   uint32_t idx = 0;
-   while (idx < UINT8_MAX) {
-      // 默认为滑过整个needle的长度
-      shift[idx] = needle->value.length;
-      idx++;
-   }
-
-   //二、假定haystack中与needle不匹配的字符在needle中之前已匹配过的位置出现过
-   //就滑动窗口以使该字符与在needle中匹配该字符的最末位置对齐。
-   //这里预先确定需要滑动的距离 
-   idx = 0; 
-   while (idx < needleEnd) {
-      char c = needle->value.start[idx];
-      //idx从前往后遍历needle,当needle中有重复的字符c时,
-      //后面的字符c会覆盖前面的同名字符c,这保证了数组shilf中字符是needle中最末位置的字符,
-      //从而保证了shilf[c]的值是needle中最末端同名字符与needle末端的偏移量
-      shift[(uint8_t)c] = needleEnd - idx;
-      idx++;
-   }
-
-   //Boyer-Moore-Horspool是从后往前比较,这是处理bad-character高效的地方,
-   //因此获取needle中最后一个字符,用于同haystack的窗口中最后一个字符比较
-   char lastChar = needle->value.start[needleEnd];
-
-   //长度差便是滑动窗口的滑动范围
-   uint32_t range = haystack->value.length - needle->value.length;
-
-   //从haystack中扫描needle,寻找第1个匹配的字符 如果遍历完了就停止
-   idx = 0;
-   while (idx <= range) {
-      //拿needle中最后一个字符同haystack窗口的最后一个字符比较
-      //(因为Boyer-Moore-Horspool是从后往前比较), 如果匹配,看整个needle是否匹配
-      char c = haystack->value.start[idx + needleEnd];
-      if (lastChar == c &&
-        memcmp(haystack->value.start + idx, needle->value.start, needleEnd) == 0) {
-         //找到了就返回匹配的位置
-         return idx;
-      }
-
-      //否则就向前滑动继续下一伦比较 
-      idx += shift[(uint8_t)c];
-   }
-
-   //未找到就返回-1
-   return -1;
+   return SearchBytes(STRING_START(haystack), haystack->value.length,
+         STRING_START(needle), needle->value.length);
 }
 
 //objString.fromCodePoint(_):从码点建立字符串
@@ -982,24 +954,28 @@ static boolean PrimStringPlus(VM* vm, Value* args) {
    ObjString* left = VALUE_TO_OBJSTR(args[0]);
    ObjString* right = VALUE_TO_OBJSTR(args[1]);
 
-   uint32_t totalLength = strlen(left->value.start) + strlen(right->value.start);
-   //+1是为了结尾的'\0'
-   ObjString* result = ALLOCATE_EXTRA(vm, ObjString, totalLength + 1);
-   if (result == NULL) {
-      MEM_ERROR("allocate memory failed in runtime!"); 
+   //一边为空串时结果就是另一边,字符串不可变,直接复用
+   if (left->value.length == 0) {
+      RET_OBJ(right);
    }
-   InitObjHeader(vm, &result->objHeader, OT_STRING, vm->stringClass);
-   memcpy(result->value.start, left->value.start, strlen(left->value.start));
-   memcpy(result->value.start + strlen(left->value.start), 
-	 right->value.start, strlen(right->value.start));
-   result->value.start[totalLength] = '\0';
-   result->value.length = totalLength;
-   HashObjString(result);
+   if (right->value.length == 0) {
+      RET_OBJ(left);
+   }
+
+   //长度已记录在value.length中,不必再strlen
+   uint32_t totalLength = left->value.length + right->value.length;
+   ObjString* result = AllocateObjString(vm, totalLength);
+   memcpy(result->value.start, STRING_START(left), left->value.length);
+   memcpy(result->value.start + left->value.length, 
+	 STRING_START(right), right->value.length);
+   result->isAscii = left->isAscii && right->isAscii;
 
    RET_OBJ(result);
 }
 
 //objString[_]:用数字或objRange对象做字符串的subscript
+//下标是字节下标而不是码点序号,取下标处的字符是O(1)的,
+//iterate返回的也是下一个字符的字节下标,按位置逐个访问字符不必从头解码
 static boolean PrimStringSubscript(VM* vm, Value* args) {
    ObjString* objString = VALUE_TO_OBJSTR(args[0]);
    //数字和objRange都可以做索引,分别判断
@@ -1040,7 +1016,7 @@ static boolean PrimStringByteAt(VM* vm UNUSED, Value* args) {
       return false; 
    }
    //故转换为数字返回
-   RET_NUM((uint8_t)objString->value.start[index]);
+   RET_NUM((uint8_t)STRING_START(objString)[index]);
 }
 
 //objString.byteCount_:返回字节数
@@ -1056,7 +1032,10 @@ static boolean PrimStringCodePointAt(VM* vm UNUSED, Value* args) {
       return false; 
    }
 
-   const uint8_t* bytes = (uint8_t*)objString->value.start;
+   const uint8_t* bytes = (uint8_t*)STRING_START(objString);
+   if (objString->isAscii) {
+      RET_NUM(bytes[index]);
+   }
    if ((bytes[index] & 0xc0) == 0x80) {
       //如果index指向的并不是utf8编码的最高字节
       //而是后面的低字节,返回-1提示用户
@@ -1064,7 +1043,7 @@ static boolean PrimStringCodePointAt(VM* vm UNUSED, Value* args) {
    }
 
    //返回解码
-   RET_NUM(DecodeUtf8((uint8_t*)objString->value.start + index,
+   RET_NUM(DecodeUtf8((uint8_t*)STRING_START(objString) + index,
 	    objString->value.length - index));
 }
 
@@ -1093,9 +1072,9 @@ static boolean PrimStringEndsWith(VM* vm UNUSED, Value* args) {
       RET_FALSE;
    }
 
-   char* cmpIdx = objString->value.start +
+   char* cmpIdx = STRING_START(objString) +
    objString->value.length - pattern->value.length;
-   RET_BOOL(memcmp(cmpIdx, pattern->value.start, pattern->value.length) == 0);
+   RET_BOOL(memcmp(cmpIdx, STRING_START(pattern), pattern->value.length) == 0);
 }
 
 //objString.indexOf(_):检索字符串args[0]中子串args[1]的起始下标
@@ -1139,6 +1118,12 @@ static boolean PrimStringIterate(VM* vm UNUSED, Value* args) {
    }
 
    uint32_t index = (uint32_t)iter;
+   //ASCII串中下一个字符就是下一个字节
+   if (objString->isAscii) {
+      index++;
+      if (index >= objString->value.length) RET_FALSE;
+      RET_NUM(index);
+   }
    do {
       index++;
 
@@ -1146,7 +1131,7 @@ static boolean PrimStringIterate(VM* vm UNUSED, Value* args) {
       if (index >= objString->value.length) RET_FALSE;
 
       //读取连续的数据字节,直到下一个Utf8的高字节
-   } while ((objString->value.start[index] & 0xc0) == 0x80);  
+   } while ((STRING_START(objString)[index] & 0xc0) == 0x80);  
 
    RET_NUM(index);
 }
@@ -1208,8 +1193,8 @@ static boolean PrimStringStartsWith(VM* vm UNUSED, Value* args) {
       RET_FALSE;
    }
 
-   RET_BOOL(memcmp(objString->value.start, 
-	    pattern->value.start, pattern->value.length) == 0);
+   RET_BOOL(memcmp(STRING_START(objString), 
+	    STRING_START(pattern), pattern->value.length) == 0);
 }
 
 //objString.toString:获得自己的字符串
@@ -1367,6 +1352,81 @@ static boolean PrimListRemoveAt(VM* vm, Value* args) {
    RET_VALUE(RemoveElement(vm, objList, index));
 }
 
+//StringBuilder的实例是所属类为StringBuilder的objList,elements中是待拼接的字符串片段
+//append只追加片段,toString时一次性拼接,反复拼接的总开销是O(n)
+
+//StringBuilder.new():创建空的StringBuilder
+static boolean PrimStringBuilderNew(VM* vm, Value* args) {
+   ObjList* builder = NewObjList(vm, 0);
+   //StringBuilder不可被继承,args[0]只能是它本身
+   SET_OBJ_CLASS(builder, vm->stringBuilderClass);
+   RET_OBJ(builder);
+}
+
+//stringBuilder.append(_):追加字符串片段,返回自身以便连续调用
+static boolean PrimStringBuilderAppend(VM* vm, Value* args) {
+   if (!ValidateString(vm, args[1])) {
+      return false;
+   }
+   ObjList* builder = VALUE_TO_OBJLIST(args[0]);
+   //空串不占片段
+   if (VALUE_TO_OBJSTR(args[1])->value.length > 0) {
+      ValueBufferAdd(vm, &builder->elements, args[1]);
+   }
+   RET_VALUE(args[0]);
+}
+
+//stringBuilder.count:已追加的字节数
+static boolean PrimStringBuilderCount(VM* vm UNUSED, Value* args) {
+   ObjList* builder = VALUE_TO_OBJLIST(args[0]);
+   uint32_t totalLength = 0, idx = 0;
+   while (idx < builder->elements.count) {
+      totalLength += VALUE_TO_OBJSTR(builder->elements.datas[idx])->value.length;
+      idx++;
+   }
+   RET_NUM(totalLength);
+}
+
+//stringBuilder.clear():清空已追加的内容
+static boolean PrimStringBuilderClear(VM* vm, Value* args) {
+   ObjList* builder = VALUE_TO_OBJLIST(args[0]);
+   ValueBufferClear(vm, &builder->elements);
+   RET_VALUE(args[0]);
+}
+
+//stringBuilder.toString:拼接所有片段
+//拼接结果替换掉原有片段,再次调用或继续追加时不必重新拼接
+static boolean PrimStringBuilderToString(VM* vm, Value* args) {
+   ObjList* builder = VALUE_TO_OBJLIST(args[0]);
+   if (builder->elements.count == 0) {
+      RET_OBJ(vm->smallStrings[SMALL_STRING_EMPTY]);
+   }
+   if (builder->elements.count == 1) {
+      RET_VALUE(builder->elements.datas[0]);
+   }
+
+   uint32_t totalLength = 0, idx = 0;
+   while (idx < builder->elements.count) {
+      totalLength += VALUE_TO_OBJSTR(builder->elements.datas[idx])->value.length;
+      idx++;
+   }
+   ObjString* result = AllocateObjString(vm, totalLength);
+   char* dest = result->value.start;
+   result->isAscii = true;
+   idx = 0;
+   while (idx < builder->elements.count) {
+      ObjString* part = VALUE_TO_OBJSTR(builder->elements.datas[idx]);
+      memcpy(dest, STRING_START(part), part->value.length);
+      dest += part->value.length;
+      result->isAscii = result->isAscii && part->isAscii;
+      idx++;
+   }
+
+   builder->elements.datas[0] = OBJ_TO_VALUE(result);
+   builder->elements.count = 1;
+   RET_OBJ(result);
+}
+
 //校验key合法性
 static boolean ValidateKey(VM* vm, Value arg) {
    if (VALUE_IS_TRUE(arg)     ||
@@ -1392,7 +1452,7 @@ static boolean PrimMapSubscript(VM* vm, Value* args) {
    ObjMap* objMap = VALUE_TO_OBJMAP(args[0]); 
 
    //从map中查找key(args[1])对应的value
-   Value value = MapGet(objMap, args[1]);
+   Value value = MapGet(vm, objMap, args[1]);
 
    //若没有相应的key则返回NULL
    if (VALUE_IS_UNDEFINED(value)) {
@@ -1449,7 +1509,7 @@ static boolean PrimMapContainsKey(VM* vm, Value* args) {
    }
 
    //直接去get该key,判断是否get成功
-   RET_BOOL(!VALUE_IS_UNDEFINED(MapGet(VALUE_TO_OBJMAP(args[0]), args[1])));
+   RET_BOOL(!VALUE_IS_UNDEFINED(MapGet(vm, VALUE_TO_OBJMAP(args[0]), args[1])));
 }
 
 //objMap.count:返回map中entry个数
@@ -1495,19 +1555,18 @@ static boolean PrimMapIterate(VM* vm, Value* args) {
 
       index = (uint32_t)VALUE_TO_NUM(args[1]);
       //迭代器不能越界
-      if (index >= objMap->capacity) {
+      if (index >= objMap->entryCount) {
 	      RET_FALSE;  
       }
 
       index++;  //更新迭代器
    }
 
-   //返回下一个正在使用(有效)的entry
-   while (index < objMap->capacity) {
-      //entries是个数组, 元素是哈希槽,
-      //哈希值散布在这些槽中并不连续,因此逐个判断槽位是否在用
-      if (!VALUE_IS_UNDEFINED(objMap->entries[index].key)) {
-	      RET_NUM(index);    //返回entry索引
+   //返回下一个在用的key的位置
+   while (index < objMap->entryCount) {
+      //key按插入顺序稠密存放,只需跳过删除留下的空位
+      if (MAP_ENTRY_IS_LIVE(objMap, index)) {
+	      RET_NUM(index);    //返回key的位置
       }
       index++;
    }
@@ -1520,18 +1579,17 @@ static boolean PrimMapIterate(VM* vm, Value* args) {
 static boolean PrimMapKeyIteratorValue(VM* vm, Value* args) {
    ObjMap* objMap = VALUE_TO_OBJMAP(args[0]);
    
-   uint32_t index = ValidateIndex(vm, args[1], objMap->capacity);
+   uint32_t index = ValidateIndex(vm, args[1], objMap->entryCount);
    if (index == UINT32_MAX) {
       return false; 
    }
 
-   Entry* entry = &objMap->entries[index];
-   if (VALUE_IS_UNDEFINED(entry->key)) {
+   if (!MAP_ENTRY_IS_LIVE(objMap, index)) {
       SET_ERROR_FALSE(vm, "inValid iterator!");
    }
 
    //返回该key
-   RET_VALUE(entry->key);   
+   RET_VALUE(MAP_ENTRY_KEY(objMap, index));   
 }
 
 //objMap.valueIteratorValue_(_): 
@@ -1539,18 +1597,92 @@ static boolean PrimMapKeyIteratorValue(VM* vm, Value* args) {
 static boolean PrimMapValueIteratorValue(VM* vm, Value* args) {
    ObjMap* objMap = VALUE_TO_OBJMAP(args[0]);
    
-   uint32_t index = ValidateIndex(vm, args[1], objMap->capacity);
+   uint32_t index = ValidateIndex(vm, args[1], objMap->entryCount);
    if (index == UINT32_MAX) {
       return false; 
    }
 
-   Entry* entry = &objMap->entries[index];
-   if (VALUE_IS_UNDEFINED(entry->key)) {
+   if (!MAP_ENTRY_IS_LIVE(objMap, index)) {
       SET_ERROR_FALSE(vm, "inValid iterator!");
    }
 
-   //返回该key
-   RET_VALUE(entry->value);   
+   //返回该value
+   RET_VALUE(objMap->values[index]);   
+}
+
+//集合的实例是OT_SET类型的ObjMap,只存key,元素的合法性同map的key
+
+//判断arg是否为集合
+static boolean ValidateSet(VM* vm, Value arg) {
+   if (VALUE_IS_OBJSET(arg)) {
+      return true;
+   }
+   SET_ERROR_FALSE(vm, "argument must be set!");
+}
+
+//Set.new():创建空集合
+static boolean PrimSetNew(VM* vm, Value* args UNUSED) {
+   RET_OBJ(NewObjSet(vm));
+}
+
+//objSet.add(_):添加元素,已有则不变,返回该元素
+static boolean PrimSetAdd(VM* vm, Value* args) {
+   if (!ValidateKey(vm, args[1])) {
+      return false;
+   }
+   MapSet(vm, VALUE_TO_OBJSET(args[0]), args[1], VT_TO_VALUE(VT_TRUE));
+   RET_VALUE(args[1]);
+}
+
+//objSet.contains(_):判断元素是否在集合中
+static boolean PrimSetContains(VM* vm, Value* args) {
+   if (!ValidateKey(vm, args[1])) {
+      return false;
+   }
+   RET_BOOL(!VALUE_IS_UNDEFINED(MapGet(vm, VALUE_TO_OBJSET(args[0]), args[1])));
+}
+
+//objSet.remove(_):删除元素,返回集合中原先是否有它
+static boolean PrimSetRemove(VM* vm, Value* args) {
+   if (!ValidateKey(vm, args[1])) {
+      return false;
+   }
+   RET_BOOL(!VALUE_IS_NULL(RemoveKey(vm, VALUE_TO_OBJSET(args[0]), args[1])));
+}
+
+//objSet.count:元素个数
+static boolean PrimSetCount(VM* vm UNUSED, Value* args) {
+   RET_NUM(VALUE_TO_OBJSET(args[0])->count);
+}
+
+//objSet.clear():清空集合
+static boolean PrimSetClear(VM* vm, Value* args) {
+   ClearMap(vm, VALUE_TO_OBJSET(args[0]));
+   RET_NULL;
+}
+
+//objSet.union(_)和objSet|(_):并集,返回新集合
+static boolean PrimSetUnion(VM* vm, Value* args) {
+   if (!ValidateSet(vm, args[1])) {
+      return false;
+   }
+   RET_OBJ(SetUnion(vm, VALUE_TO_OBJSET(args[0]), VALUE_TO_OBJSET(args[1])));
+}
+
+//objSet.intersect(_)和objSet&(_):交集,返回新集合
+static boolean PrimSetIntersect(VM* vm, Value* args) {
+   if (!ValidateSet(vm, args[1])) {
+      return false;
+   }
+   RET_OBJ(SetIntersect(vm, VALUE_TO_OBJSET(args[0]), VALUE_TO_OBJSET(args[1])));
+}
+
+//objSet.difference(_)和objSet-(_):差集,返回新集合
+static boolean PrimSetDifference(VM* vm, Value* args) {
+   if (!ValidateSet(vm, args[1])) {
+      return false;
+   }
+   RET_OBJ(SetDifference(vm, VALUE_TO_OBJSET(args[0]), VALUE_TO_OBJSET(args[1])));
 }
 
 static boolean PrimRangeFrom(VM* vm UNUSED, Value* args) {
@@ -1666,11 +1798,12 @@ static void PrintString(const char* str) {
 //导入模块moduleName,主要是把编译模块并加载到vm->allModules
 static Value ImportModule(VM* vm, Value moduleName) {
    //若已经导入则返回NULL_VAL
-   if (!VALUE_IS_UNDEFINED(MapGet(vm->allModules, moduleName))) {
+   if (!VALUE_IS_UNDEFINED(MapGet(vm, vm->allModules, moduleName))) {
       return VT_TO_VALUE(VT_NULL);   
    }
    ObjString* objString = VALUE_TO_OBJSTR(moduleName);
-   const char* sourceCode = ReadModule(objString->value.start);
+   MaterializeString(vm, objString); //切片不以\0结尾
+   const char* sourceCode = ReadModule(STRING_START(objString));
 
    ObjThread* moduleThread = LoadModule(vm, moduleName, sourceCode);
    return OBJ_TO_VALUE(moduleThread);
@@ -1686,7 +1819,8 @@ static Value GetModuleVariable(VM* vm, Value moduleName, Value variableName) {
       //24是下面sprintf中fmt中除%s的字符个数
       ASSERT(modName->value.length < 512 - 24, "id`s buffer not big enough!");
       char id[512] = {'\0'};
-      int len = sprintf(id, "module \'%s\' is not loaded!", modName->value.start);
+      int len = sprintf(id, "module \'%.*s\' is not loaded!",
+            (int)modName->value.length, STRING_START(modName));
       vm->curThread->errorObj = OBJ_TO_VALUE(NewObjString(vm, id, len));
       return VT_TO_VALUE(VT_NULL);
    }
@@ -1695,15 +1829,16 @@ static Value GetModuleVariable(VM* vm, Value moduleName, Value variableName) {
 
    //从moduleVarName中获得待导入的模块变量
    int index = GetIndexFromSymbolTable(&objModule->moduleVarName,
-	     varName->value.start, varName->value.length);
+	     STRING_START(varName), varName->value.length);
 
    if (index == -1) {
       //32是下面sprintf中fmt中除%s的字符个数
       ASSERT(varName->value.length < 512 - 32, "id`s buffer not big enough!");
       ObjString* modName = VALUE_TO_OBJSTR(moduleName);
       char id[512] = {'\0'};
-      int len = sprintf(id, "variable \'%s\' is not in module \'%s\'!",
-	    varName->value.start, modName->value.start);
+      int len = sprintf(id, "variable \'%.*s\' is not in module \'%.*s\'!",
+	    (int)varName->value.length, STRING_START(varName),
+	    (int)modName->value.length, STRING_START(modName));
       vm->curThread->errorObj = OBJ_TO_VALUE(NewObjString(vm, id, len));
       return VT_TO_VALUE(VT_NULL);
    }
@@ -1766,18 +1901,216 @@ static boolean PrimSystemGetModuleVariable(VM* vm, Value* args) {
 }
 
 //System.writeString_(_): 输出字符串args[1]
-static boolean PrimSystemWriteString(VM* vm UNUSED, Value* args) {
+static boolean PrimSystemWriteString(VM* vm, Value* args) {
    ObjString* objString = VALUE_TO_OBJSTR(args[1]);
-   ASSERT(objString->value.start[objString->value.length] == '\0', "string isn`t terminated!");
-   PrintString(objString->value.start);
+   MaterializeString(vm, objString); //切片不以\0结尾
+   ASSERT(STRING_START(objString)[objString->value.length] == '\0', "string isn`t terminated!");
+   PrintString(STRING_START(objString));
    RET_VALUE(args[1]);
 }
 
+//把数值num以key为键存入map
+static void MapSetNum(VM* vm, ObjMap* objMap, const char* key, double num) {
+   MapSet(vm, objMap, OBJ_TO_VALUE(NewObjString(vm, key, strlen(key))), NUM_TO_VALUE(num));
+}
+
+//System.gcStats: 以map返回GC统计,时间单位为秒
+static boolean PrimSystemGcStats(VM* vm, Value* args UNUSED) {
+   GCStats* stats = &vm->gcStats;
+   ObjMap* result = NewObjMap(vm);
+   MapSetNum(vm, result, "gcNum", stats->gcNum);
+   MapSetNum(vm, result, "compactNum", stats->compactNum);
+   MapSetNum(vm, result, "markTime", stats->markNs / 1e9);
+   MapSetNum(vm, result, "sweepTime", stats->sweepNs / 1e9);
+   MapSetNum(vm, result, "compactTime", stats->compactNs / 1e9);
+   MapSetNum(vm, result, "lastPause", stats->lastPauseNs / 1e9);
+   MapSetNum(vm, result, "maxPause", stats->maxPauseNs / 1e9);
+   MapSetNum(vm, result, "reclaimedBytes", stats->reclaimedBytes);
+   MapSetNum(vm, result, "allocatedBytes", vm->allocatedBytes);
+
+   //pauseHistogram[i]为停顿在[2^i, 2^(i+1))微秒内的次数
+   ObjList* histogram = NewObjList(vm, GC_PAUSE_BUCKET_NUM);
+   uint32_t idx = 0;
+   while (idx < GC_PAUSE_BUCKET_NUM) {
+      histogram->elements.datas[idx] = NUM_TO_VALUE(stats->pauseHistogram[idx]);
+      idx++;
+   }
+   MapSet(vm, result, OBJ_TO_VALUE(NewObjString(vm, "pauseHistogram", 14)), OBJ_TO_VALUE(histogram));
+
+   //live为各类型的存活对象数和字节数,形如{"string": {"objects": n, "bytes": m}}
+   ObjMap* live = NewObjMap(vm);
+   MapSet(vm, result, OBJ_TO_VALUE(NewObjString(vm, "live", 4)), OBJ_TO_VALUE(live));
+   idx = 0;
+   while (idx < GC_OBJ_TYPE_NUM) {
+      ObjMap* typeStats = NewObjMap(vm);
+      const char* typeName = GCStatsTypeName((ObjType)idx);
+      MapSet(vm, live, OBJ_TO_VALUE(NewObjString(vm, typeName, strlen(typeName))), OBJ_TO_VALUE(typeStats));
+      MapSetNum(vm, typeStats, "objects", stats->live[idx].objectNum);
+      MapSetNum(vm, typeStats, "bytes", stats->live[idx].bytes);
+      idx++;
+   }
+   RET_OBJ(result);
+}
+
+//以map返回当前的GC配置
+static ObjMap* NewGcConfigMap(VM* vm) {
+   ObjMap* config = NewObjMap(vm);
+   MapSetNum(vm, config, "heapGrowthFactor", vm->config.heapGrowthFactor);
+   MapSetNum(vm, config, "minHeapSize", vm->config.minHeapSize);
+   MapSetNum(vm, config, "maxHeapSize", vm->config.maxHeapSize);
+   MapSetNum(vm, config, "markThreads", vm->config.markThreads);
+   MapSetNum(vm, config, "compactThreshold", vm->config.compactThreshold);
+   MapSet(vm, config, OBJ_TO_VALUE(NewObjString(vm, "enableCompact", 13)),
+         BOOL_TO_VALUE(vm->config.enableCompact));
+   return config;
+}
+
+//堆大小转为uint64_t,不小于2^64的数转换是未定义行为
+#define GC_MAX_HEAP_SIZE_NUM 18446744073709551616.0
+
+//校验一项GC配置并写入config,key为配置名
+static boolean SetGcConfig(VM* vm, Configuration* config, ObjString* key, Value value) {
+   const char* name = STRING_START(key);
+   if (strcmp(name, "enableCompact") == 0) {
+      if (!VALUE_IS_TRUE(value) && !VALUE_IS_FALSE(value)) {
+         SET_ERROR_FALSE(vm, "enableCompact must be bool!");
+      }
+      config->enableCompact = VALUE_TO_BOOL(value);
+      return true;
+   }
+
+   //其余配置项都是有限的非负数,NaN和无穷不能通过后面逐项的比较,须先排除
+   if (!VALUE_IS_NUM(value) || !isfinite(value.num) || value.num < 0) {
+      char msg[128];
+      int len = snprintf(msg, sizeof(msg), "gc config '%s' must be a non-negative number!", name);
+      vm->curThread->errorObj = OBJ_TO_VALUE(NewObjString(vm, msg, len));
+      return false;
+   }
+   double num = value.num;
+   if (strcmp(name, "heapGrowthFactor") == 0) {
+      if (num <= 1) {
+         SET_ERROR_FALSE(vm, "heapGrowthFactor must be greater than 1!");
+      }
+      config->heapGrowthFactor = num;
+   } else if (strcmp(name, "minHeapSize") == 0) {
+      if (num >= GC_MAX_HEAP_SIZE_NUM) {
+         SET_ERROR_FALSE(vm, "minHeapSize is too large!");
+      }
+      config->minHeapSize = (uint64_t)num;
+   } else if (strcmp(name, "maxHeapSize") == 0) {
+      if (num >= GC_MAX_HEAP_SIZE_NUM) {
+         SET_ERROR_FALSE(vm, "maxHeapSize is too large!");
+      }
+      config->maxHeapSize = (uint64_t)num;
+   } else if (strcmp(name, "markThreads") == 0) {
+      if (num < 1 || num > MAX_MARK_THREADS || trunc(num) != num) {
+         char msg[128];
+         int len = snprintf(msg, sizeof(msg), "markThreads must be an integer in [1, %d]!", MAX_MARK_THREADS);
+         vm->curThread->errorObj = OBJ_TO_VALUE(NewObjString(vm, msg, len));
+         return false;
+      }
+      config->markThreads = (uint32_t)num;
+   } else if (strcmp(name, "compactThreshold") == 0) {
+      if (num > 1) {
+         SET_ERROR_FALSE(vm, "compactThreshold must be in [0, 1]!");
+      }
+      config->compactThreshold = num;
+   } else {
+      char msg[128];
+      int len = snprintf(msg, sizeof(msg), "unknown gc config '%s'!", name);
+      vm->curThread->errorObj = OBJ_TO_VALUE(NewObjString(vm, msg, len));
+      return false;
+   }
+   return true;
+}
+
+//System.gc(): 请求一次完整的垃圾回收
+static boolean PrimSystemGc(VM* vm, Value* args UNUSED) {
+   //原生方法中可能持有未入根的对象,不能在此直接回收,由下一个安全点执行
+   vm->gcPending = true;
+   RET_NULL;
+}
+
+//System.gcConfigure(_): 用map args[1]中的项修改GC配置,返回修改后的配置
+static boolean PrimSystemGcConfigure(VM* vm, Value* args) {
+   if (!VALUE_IS_OBJMAP(args[1])) {
+      SET_ERROR_FALSE(vm, "argument must be map!");
+   }
+   ObjMap* objMap = VALUE_TO_OBJMAP(args[1]);
+   //先在副本上校验并修改全部配置项,都合法才生效,出错时原配置不变
+   Configuration config = vm->config;
+   uint32_t idx = 0;
+   while (idx < objMap->entryCount) {
+      if (!MAP_ENTRY_IS_LIVE(objMap, idx)) {
+         idx++;
+         continue;
+      }
+      Value key = MAP_ENTRY_KEY(objMap, idx);
+      if (!VALUE_IS_OBJSTR(key)) {
+         SET_ERROR_FALSE(vm, "gc config name must be string!");
+      }
+      if (!SetGcConfig(vm, &config, VALUE_TO_OBJSTR(key), objMap->values[idx])) {
+         return false;
+      }
+      idx++;
+   }
+   if (config.maxHeapSize != 0 && config.minHeapSize > config.maxHeapSize) {
+      SET_ERROR_FALSE(vm, "minHeapSize must not exceed maxHeapSize!");
+   }
+
+   //阈值要落在新的上下限之间
+   if (config.nextGC < config.minHeapSize) {
+      config.nextGC = config.minHeapSize;
+   }
+   if (config.maxHeapSize != 0 && config.nextGC > config.maxHeapSize) {
+      config.nextGC = config.maxHeapSize;
+   }
+   vm->config = config;
+   RET_OBJ(NewGcConfigMap(vm));
+}
+
+//System.gcConfig: 以map返回当前GC配置
+static boolean PrimSystemGcConfig(VM* vm, Value* args UNUSED) {
+   RET_OBJ(NewGcConfigMap(vm));
+}
+
+//System.gcPause(): 进入不做GC的区域,可嵌套,与gcResume()配对使用
+static boolean PrimSystemGcPause(VM* vm, Value* args UNUSED) {
+   vm->gcPauseDepth++;
+   RET_NULL;
+}
+
+//System.gcResume(): 离开不做GC的区域,积压的GC请求在下一个安全点处理
+static boolean PrimSystemGcResume(VM* vm, Value* args UNUSED) {
+   if (vm->gcPauseDepth == 0) {
+      SET_ERROR_FALSE(vm, "gcResume() without gcPause()!");
+   }
+   vm->gcPauseDepth--;
+   RET_NULL;
+}
+
+//System.heapSize: 当前已分配的内存量
+static boolean PrimSystemHeapSize(VM* vm, Value* args UNUSED) {
+   RET_NUM((double)vm->allocatedBytes);
+}
+
+//System.nextGC: 下次触发GC的内存量
+static boolean PrimSystemNextGC(VM* vm, Value* args UNUSED) {
+   RET_NUM((double)vm->config.nextGC);
+}
+
 //objMap.new():创建map对象
 static boolean PrimMapNew(VM* vm, Value* args UNUSED) {
    RET_OBJ(NewObjMap(vm));
 }
 
+//自举时创建的字符串还没有类,遍历堆补上
+static void SetStringClass(void* obj, void* vm) {
+   if (OBJ_TYPE(obj) == OT_STRING) {
+      SET_OBJ_CLASS(obj, ((VM*)vm)->stringClass);
+   }
+}
+
 /**
  * @brief 编译核心模块
  * @details 在读取源码文件之前，先编译核心模块
@@ -1815,9 +2148,18 @@ void BuildCore(VM *vm)
     PRIM_METHOD_BIND(objectMetaClass, "Same(_,_)", PrimObjectMetaSame);
 
     // 绑定各自的meta类
-    vm->objectClass->objHeader.class = objectMetaClass;
-    objectMetaClass->objHeader.class = vm->classOfClass;
-    vm->classOfClass->objHeader.class = vm->classOfClass; // 元信息类回路，meta类终点
+    SET_OBJ_CLASS(vm->objectClass, objectMetaClass);
+    SET_OBJ_CLASS(objectMetaClass, vm->classOfClass);
+    SET_OBJ_CLASS(vm->classOfClass, vm->classOfClass); // 元信息类回路，meta类终点
+
+    // StringBuilder在执行核心模块之前定义，核心模块中的字符串内嵌表达式也要用它
+    vm->stringBuilderClass = NewClass(vm, InternString(vm, "StringBuilder", 13), 0, vm->objectClass);
+    DefineModuleVar(vm, coreModule, "StringBuilder", 13, OBJ_TO_VALUE(vm->stringBuilderClass));
+    PRIM_METHOD_BIND(OBJ_CLASS(vm->stringBuilderClass), "new()", PrimStringBuilderNew);
+    PRIM_METHOD_BIND(vm->stringBuilderClass, "append(_)", PrimStringBuilderAppend);
+    PRIM_METHOD_BIND(vm->stringBuilderClass, "count", PrimStringBuilderCount);
+    PRIM_METHOD_BIND(vm->stringBuilderClass, "clear()", PrimStringBuilderClear);
+    PRIM_METHOD_BIND(vm->stringBuilderClass, "toString", PrimStringBuilderToString);
 
     // 执行核心模块 CORE_MODULE
     ExecuteModule(vm, CORE_MODULE, g_coreModuleCode);
@@ -1830,8 +2172,8 @@ void BuildCore(VM *vm)
    //绑定num类方法
    vm->numClass = VALUE_TO_CLASS(GetCoreClassValue(coreModule, "Num"));
    //类方法
-   PRIM_METHOD_BIND(vm->numClass->objHeader.class, "fromString(_)", PrimNumFromString);
-   PRIM_METHOD_BIND(vm->numClass->objHeader.class, "pi", PrimNumPi);
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->numClass), "fromString(_)", PrimNumFromString);
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->numClass), "pi", PrimNumPi);
    //实例方法 
    PRIM_METHOD_BIND(vm->numClass, "+(_)", PrimNumPlus);
    PRIM_METHOD_BIND(vm->numClass, "-(_)", PrimNumMinus);
@@ -1882,7 +2224,7 @@ void BuildCore(VM *vm)
 
    //绑定函数类
    vm->fnClass = VALUE_TO_CLASS(GetCoreClassValue(coreModule, "Fn"));
-   PRIM_METHOD_BIND(vm->fnClass->objHeader.class, "new(_)", PrimFnNew);
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->fnClass), "new(_)", PrimFnNew);
 
    //绑定call的重载方法
    BindFnOverloadCall(vm, "call()");
@@ -1907,20 +2249,23 @@ void BuildCore(VM *vm)
    //将其挂载到vm->threadClass并补充原生方法
    vm->threadClass = VALUE_TO_CLASS(GetCoreClassValue(coreModule, "Thread"));
    //以下是类方法
-   PRIM_METHOD_BIND(vm->threadClass->objHeader.class, "new(_)", PrimThreadNew);
-   PRIM_METHOD_BIND(vm->threadClass->objHeader.class, "abort(_)", PrimThreadAbort);
-   PRIM_METHOD_BIND(vm->threadClass->objHeader.class, "current", PrimThreadCurrent);
-   PRIM_METHOD_BIND(vm->threadClass->objHeader.class, "suspend()", PrimThreadSuspend);
-   PRIM_METHOD_BIND(vm->threadClass->objHeader.class, "yield(_)", PrimThreadYieldWithArg);
-   PRIM_METHOD_BIND(vm->threadClass->objHeader.class, "yield()", PrimThreadYieldWithoutArg);
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->threadClass), "new(_)", PrimThreadNew);
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->threadClass), "abort(_)", PrimThreadAbort);
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->threadClass), "current", PrimThreadCurrent);
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->threadClass), "suspend()", PrimThreadSuspend);
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->threadClass), "yield(_)", PrimThreadYieldWithArg);
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->threadClass), "yield()", PrimThreadYieldWithoutArg);
    //以下是实例方法
    PRIM_METHOD_BIND(vm->threadClass, "call()", PrimThreadCallWithoutArg);
    PRIM_METHOD_BIND(vm->threadClass, "call(_)", PrimThreadCallWithArg);
    PRIM_METHOD_BIND(vm->threadClass, "isDone", PrimThreadIsDone);
+   PRIM_METHOD_BIND(vm->threadClass, "try()", PrimThreadTryWithoutArg);
+   PRIM_METHOD_BIND(vm->threadClass, "try(_)", PrimThreadTryWithArg);
+   PRIM_METHOD_BIND(vm->threadClass, "error", PrimThreadError);
 
    //字符串类
    vm->stringClass = VALUE_TO_CLASS(GetCoreClassValue(coreModule, "String"));
-   PRIM_METHOD_BIND(vm->stringClass->objHeader.class, "fromCodePoint(_)", PrimStringFromCodePoint);
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->stringClass), "fromCodePoint(_)", PrimStringFromCodePoint);
    PRIM_METHOD_BIND(vm->stringClass, "+(_)", PrimStringPlus);
    PRIM_METHOD_BIND(vm->stringClass, "[_]", PrimStringSubscript);
    PRIM_METHOD_BIND(vm->stringClass, "byteAt_(_)", PrimStringByteAt);
@@ -1938,7 +2283,7 @@ void BuildCore(VM *vm)
 
    //List类
    vm->listClass = VALUE_TO_CLASS(GetCoreClassValue(coreModule, "List"));
-   PRIM_METHOD_BIND(vm->listClass->objHeader.class, "new()", PrimListNew);
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->listClass), "new()", PrimListNew);
    PRIM_METHOD_BIND(vm->listClass, "[_]", PrimListSubscript);
    PRIM_METHOD_BIND(vm->listClass, "[_]=(_)", PrimListSubscriptSetter);
    PRIM_METHOD_BIND(vm->listClass, "add(_)", PrimListAdd);
@@ -1952,7 +2297,7 @@ void BuildCore(VM *vm)
 
    //map类
    vm->mapClass = VALUE_TO_CLASS(GetCoreClassValue(coreModule, "Map"));
-   PRIM_METHOD_BIND(vm->mapClass->objHeader.class, "new()", PrimMapNew);
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->mapClass), "new()", PrimMapNew);
    PRIM_METHOD_BIND(vm->mapClass, "[_]", PrimMapSubscript);
    PRIM_METHOD_BIND(vm->mapClass, "[_]=(_)", PrimMapSubscriptSetter);
    PRIM_METHOD_BIND(vm->mapClass, "addCore_(_,_)", PrimMapAddCore);
@@ -1964,6 +2309,23 @@ void BuildCore(VM *vm)
    PRIM_METHOD_BIND(vm->mapClass, "keyIteratorValue_(_)", PrimMapKeyIteratorValue);
    PRIM_METHOD_BIND(vm->mapClass, "valueIteratorValue_(_)", PrimMapValueIteratorValue);
 
+   //set类,迭代与map的key相同,直接复用
+   vm->setClass = VALUE_TO_CLASS(GetCoreClassValue(coreModule, "Set"));
+   PRIM_METHOD_BIND(OBJ_CLASS(vm->setClass), "new()", PrimSetNew);
+   PRIM_METHOD_BIND(vm->setClass, "add(_)", PrimSetAdd);
+   PRIM_METHOD_BIND(vm->setClass, "contains(_)", PrimSetContains);
+   PRIM_METHOD_BIND(vm->setClass, "remove(_)", PrimSetRemove);
+   PRIM_METHOD_BIND(vm->setClass, "count", PrimSetCount);
+   PRIM_METHOD_BIND(vm->setClass, "clear()", PrimSetClear);
+   PRIM_METHOD_BIND(vm->setClass, "union(_)", PrimSetUnion);
+   PRIM_METHOD_BIND(vm->setClass, "|(_)", PrimSetUnion);
+   PRIM_METHOD_BIND(vm->setClass, "intersect(_)", PrimSetIntersect);
+   PRIM_METHOD_BIND(vm->setClass, "&(_)", PrimSetIntersect);
+   PRIM_METHOD_BIND(vm->setClass, "difference(_)", PrimSetDifference);
+   PRIM_METHOD_BIND(vm->setClass, "-(_)", PrimSetDifference);
+   PRIM_METHOD_BIND(vm->setClass, "iterate(_)", PrimMapIterate);
+   PRIM_METHOD_BIND(vm->setClass, "iteratorValue(_)", PrimMapKeyIteratorValue);
+
    //range类
    vm->rangeClass = VALUE_TO_CLASS(GetCoreClassValue(coreModule, "Range"));
    PRIM_METHOD_BIND(vm->rangeClass, "from", PrimRangeFrom);
@@ -1975,17 +2337,19 @@ void BuildCore(VM *vm)
 
    //system类
    Class* systemClass = VALUE_TO_CLASS(GetCoreClassValue(coreModule, "System"));
-   PRIM_METHOD_BIND(systemClass->objHeader.class, "clock", PrimSystemClock);
-   PRIM_METHOD_BIND(systemClass->objHeader.class, "importModule(_)", PrimSystemImportModule);
-   PRIM_METHOD_BIND(systemClass->objHeader.class, "getModuleVariable(_,_)", PrimSystemGetModuleVariable);
-   PRIM_METHOD_BIND(systemClass->objHeader.class, "writeString_(_)", PrimSystemWriteString);
+   PRIM_METHOD_BIND(OBJ_CLASS(systemClass), "clock", PrimSystemClock);
+   PRIM_METHOD_BIND(OBJ_CLASS(systemClass), "importModule(_)", PrimSystemImportModule);
+   PRIM_METHOD_BIND(OBJ_CLASS(systemClass), "getModuleVariable(_,_)", PrimSystemGetModuleVariable);
+   PRIM_METHOD_BIND(OBJ_CLASS(systemClass), "writeString_(_)", PrimSystemWriteString);
+   PRIM_METHOD_BIND(OBJ_CLASS(systemClass), "gcStats", PrimSystemGcStats);
+   PRIM_METHOD_BIND(OBJ_CLASS(systemClass), "gc()", PrimSystemGc);
+   PRIM_METHOD_BIND(OBJ_CLASS(systemClass), "gcConfigure(_)", PrimSystemGcConfigure);
+   PRIM_METHOD_BIND(OBJ_CLASS(systemClass), "gcConfig", PrimSystemGcConfig);
+   PRIM_METHOD_BIND(OBJ_CLASS(systemClass), "gcPause()", PrimSystemGcPause);
+   PRIM_METHOD_BIND(OBJ_CLASS(systemClass), "gcResume()", PrimSystemGcResume);
+   PRIM_METHOD_BIND(OBJ_CLASS(systemClass), "heapSize", PrimSystemHeapSize);
+   PRIM_METHOD_BIND(OBJ_CLASS(systemClass), "nextGC", PrimSystemNextGC);
 
    // 在核心自举创建了很多objstring对象
-   ObjHeader *objHeader = vm->allObjects;
-   while (objHeader != NULL) {
-      if (objHeader->type == OT_STRING) {
-         objHeader->class = vm->stringClass;
-      }
-      objHeader = objHeader->next;
-   }
+   HeapWalk(&vm->heap, SetStringClass, vm);
 }
\ No newline at end of file
@@ -5,19 +5,29 @@
  */
 #include "vm.h"
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "utils.h"
 #include "obj_thread.h"
 #include "header_obj.h"
 #include "compile.h"
 #include "core.h"
+#include "gc.h"
+#include "hash.h"
 
 void InitVM(VM *vm)
 {
+    // 对象头把类地址和类型合在一个字里，核心类建立之前创建的对象须取到NULL而不是残留值
+    memset(vm, 0, sizeof(VM));
     vm->allocatedBytes = 0;
+    vm->hashSeed = NewHashSeed(vm);
     vm->curParser = NULL;
-    vm->allObjects = NULL;
+    vm->curThread = NULL;
+    vm->tmpRootNum = 0;
+    InitHeap(&vm->heap);
+    InitLargeSpace(&vm->largeSpace);
     StringBufferInit(&vm->allMethodNames);
-    vm->allModules = NewObjMap(vm);
+    InitStringTable(&vm->strings);
     vm->config.heapGrowthFactor = 1.5;
 
     // 最小堆大小为1MB
@@ -25,11 +35,29 @@ void InitVM(VM *vm)
     // 初始堆大小为10MB
     vm->config.initialHeapSize = 1024 * 1024 * 10;
 
+    // 默认不限制堆大小
+    vm->config.maxHeapSize = 0;
+
     vm->config.nextGC = vm->config.initialHeapSize;
+    vm->gcPending = false;
+    vm->gcPauseDepth = 0;
+    InitGCStats(&vm->gcStats);
+    // 堆整理默认关闭，开启后碎片率超过一半时整理
+    vm->config.enableCompact = false;
+    vm->config.compactThreshold = 0.5;
+    vm->compactPending = false;
+    // 标记线程数默认取在线CPU数，不超过MAX_MARK_THREADS
+    long cpuNum = sysconf(_SC_NPROCESSORS_ONLN);
+    vm->config.markThreads = cpuNum < 1 ? 1 : (cpuNum > MAX_MARK_THREADS ? MAX_MARK_THREADS : (uint32_t)cpuNum);
     vm->grays.count = 0;
     vm->grays.capacity = 32;
 
     vm->grays.grayObjects = (ObjHeader **)malloc(vm->grays.capacity * sizeof(ObjHeader *));
+
+    // 分配对象时要与config.nextGC比较，GC配置就绪后才能创建对象
+    // 此时stringClass还是NULL，这些串的类由BuildCore末尾的HeapWalk(SetStringClass)补上
+    InitSmallStrings(vm);
+    vm->allModules = NewObjMap(vm);
 }
 
 VM* NewVM(void)
@@ -48,7 +76,15 @@ VM* NewVM(void)
 */
 void FreeVM(VM *vm)
 {
-    
+    // 字符串表只弱引用堆中的字符串，先于堆释放
+    FreeStringTable(&vm->strings);
+    // 对象的附属内存可能落在大块内存空间中，须在其解除映射之前释放
+    FreeAllObjects(vm);
+    FreeHeap(&vm->heap);
+    FreeLargeSpace(&vm->largeSpace);
+    SymbolTableClear(vm, &vm->allMethodNames);
+    free(vm->grays.grayObjects);
+    free(vm);
 }
 
 /**
@@ -67,7 +103,7 @@ void EnsureStack(VM *vm, ObjThread *objThread, const uint32_t needSlots)
     // 记录原栈底以用于下面判断扩容后的栈是否原地扩容
     Value *oldStackBottom = objThread->stack;
     uint32_t slotSize = sizeof(Value);
-    objThread->stack = (Value *)MemManager(vm, objThread->stack, objThread->stackCapacity * slotSize, newStackCapacity);
+    objThread->stack = (Value *)MemManager(vm, objThread->stack, objThread->stackCapacity * slotSize, newStackCapacity * slotSize);
     objThread->stackCapacity = newStackCapacity;
 
     // 判断是否原地扩容
@@ -177,20 +213,22 @@ static void IsValidateSuperClass(VM *vm, Value classNameValue, uint32_t fieldNum
 {
     if (!VALUE_IS_CLASS(superClassValue)) {
         ObjString *classNameString = VALUE_TO_OBJSTR(classNameValue);
-        RUNTIME_ERROR("Class \"$s\" 's superClass is not a valid class!", classNameString->value.start);
+        RUNTIME_ERROR("Class \"$s\" 's superClass is not a valid class!", STRING_START(classNameString));
     }
 
     Class *superClass = VALUE_TO_CLASS(superClassValue);
     // 基类不允许内建类
     if ((superClass == vm->stringClass) ||
         (superClass == vm->mapClass)    ||
+        (superClass == vm->setClass)    ||
         (superClass == vm->rangeClass)  ||
         (superClass == vm->listClass)   ||
         (superClass == vm->nullClass)   ||
         (superClass == vm->boolClass)   ||
         (superClass == vm->numClass)    ||
         (superClass == vm->fnClass)     ||
-        (superClass == vm->threadClass)) {
+        (superClass == vm->threadClass) ||
+        (superClass == vm->stringBuilderClass)) {
         RUNTIME_ERROR("SuperClass mustn't be a build in class!");
     }
 
@@ -267,7 +305,7 @@ static void BindMethodAndPatch(VM *vm, OpCode opCode, uint32_t methodIdx, Class
 {
     // 如果是静态方法，就将类指向meta类
     if (opCode == OPCODE_STATIC_METHOD) {
-        class = class->objHeader.class;
+        class = OBJ_CLASS(class);
     }
 
     Method method;
@@ -279,6 +317,33 @@ static void BindMethodAndPatch(VM *vm, OpCode opCode, uint32_t methodIdx, Class
     BindMethod(vm, class, methodIdx, method);
 }
 
+/**
+ * @brief 当前线程以errorObj中的错误结束，错误沿调用链向上传播
+ *          逐级结束未用try调用的主调线程，错误也存入它们的errorObj
+ *          遇到用try调用的线程时，错误作为try的结果放在其主调方栈顶，返回true
+ *          传播到最外层线程时返回false，由调用者报错
+*/
+static boolean PropagateThreadError(VM *vm)
+{
+    ObjThread *failedThread = vm->curThread;
+    Value error = failedThread->errorObj;
+    while (failedThread->caller != NULL && !failedThread->isTry) {
+        ObjThread *callerThread = failedThread->caller;
+        failedThread->caller = NULL;
+        callerThread->errorObj = error;
+        failedThread = callerThread;
+    }
+    if (failedThread->caller == NULL) {
+        vm->curThread = failedThread;
+        return false;
+    }
+    vm->curThread = failedThread->caller;
+    failedThread->caller = NULL;
+    failedThread->isTry = false;
+    vm->curThread->esp[-1] = error;
+    return true;
+}
+
 /**
  * @brief 执行指令
 */
@@ -315,6 +380,21 @@ VMResult ExecuteInstruction(VM *vm, register ObjThread *curThread)
     #define CASE(shortOpCode) case OPCODE_##shortOpCode
     #define LOOP() goto loopStart
 
+    // 安全点：对象引用都在vm能找到的根中，可以GC和搬迁对象
+    // 超出堆上限时当前线程以out of memory错误结束，按PropagateThreadError传播
+    // 没有try接住时报错并返回VM_RESULT_ERROR
+    #define SAFEPOINT() \
+        if (vm->gcPending || vm->compactPending) { \
+            STORE_CUR_FRAME(); \
+            if (!GCSafepoint(vm) && !PropagateThreadError(vm)) { \
+                fprintf(stderr, "%s\n", STRING_START(VALUE_TO_OBJSTR(vm->curThread->errorObj))); \
+                return VM_RESULT_ERROR; \
+            } \
+            /* 线程对象及闭包可能已被搬迁，重新加载 */ \
+            curThread = vm->curThread; \
+            LOAD_CUR_FRAME(); \
+        }
+
     LOAD_CUR_FRAME();
     DECODE {
         // 第一部分操作码
@@ -417,6 +497,8 @@ VMResult ExecuteInstruction(VM *vm, register ObjThread *curThread)
                     default:
                         NOT_REACHED(); // 不可达
                 }
+            // 函数入口是安全点，没有循环的递归调用也能到达
+            SAFEPOINT();
             LOOP();
         }
         CASE(LOAD_UPVALUE): // 指令流1 upvalue的索引
@@ -470,6 +552,8 @@ VMResult ExecuteInstruction(VM *vm, register ObjThread *curThread)
             int16_t offset = READ_SHORT();
             // TODO: assert
             ip -= offset;
+            // 回跳处是安全点
+            SAFEPOINT();
             LOOP();
         }
         CASE(JUMP_IF_FALSE): {
@@ -544,6 +628,10 @@ VMResult ExecuteInstruction(VM *vm, register ObjThread *curThread)
                 stackStart[0] = retVal;
                 curThread->esp = stackStart + 1; // 回收堆栈
             }
+            // 返回处是安全点，返回值已在栈上
+            SAFEPOINT();
+            LOAD_CUR_FRAME();
+            LOOP();
         }
         CASE(CONSTRUCT): {
             // 栈底 stackStart[0]=class
@@ -622,6 +710,7 @@ VMResult ExecuteInstruction(VM *vm, register ObjThread *curThread)
     #undef PEEK2
     #undef LOAD_CUR_FRAME
     #undef STORE_CUR_FRAME
+    #undef SAFEPOINT
     #undef READ_BYTE
     #undef READ_SHORT
 }
@@ -636,5 +725,5 @@ void PushTmpRoot(VM *vm, ObjHeader *obj)
 
 void PopTmpRoot(VM *vm)
 {
-    vm->tmpRootNum ++;
+    vm->tmpRootNum --;
 }
@@ -10,6 +10,9 @@
 #include "header_obj.h"
 #include "obj_map.h"
 #include "obj_thread.h"
+#include "obj_string.h"
+#include "gc_stats.h"
+#include "large_space.h"
 #include <stdint.h>
 
 #define MAX_TEMP_ROOTS_NUM 8 // 最多临时根对象数量
@@ -33,23 +36,32 @@ typedef struct gray {
 } Gray; // 灰色对象信息结构
 
 typedef struct configuration {
-    int heapGrowthFactor; // 堆生长因子
-    uint32_t initialHeapSize; // 初始堆大小
-    uint32_t minHeapSize; // 最小堆大小
-    uint32_t nextGC; // 第一次出发GC堆的大小，默认为initialHeapSize
+    double heapGrowthFactor; // 堆生长因子，GC后下次触发GC的阈值为存活内存量乘以此值
+    uint64_t initialHeapSize; // 初始堆大小
+    uint64_t minHeapSize; // 最小堆大小
+    uint64_t maxHeapSize; // 堆的硬上限，GC后存活内存仍超过此值时报错，0表示不限制
+    uint64_t nextGC; // 第一次出发GC堆的大小，默认为initialHeapSize
+    boolean enableCompact; // 是否开启堆整理
+    double compactThreshold; // 碎片率超过此值时在安全点整理堆
+    uint32_t markThreads; // 标记阶段使用的线程数，为1时单线程标记
 } Configuration;
 
 struct vm {
-    uint32_t allocatedBytes; // 累计已分配的内存量
+    uint64_t allocatedBytes; // 累计已分配的内存量
+    uint64_t hashSeed; // 字符串和数字哈希的种子，每个虚拟机随机选取
     Parser *curParser; // 当前词法分析器
-    ObjHeader *allObjects; // 所有已分配对象链表
+    Heap heap; // 对象堆
+    LargeSpace largeSpace; // 大块缓冲区所在的映射区
     SymbolTable allMethodNames; // 所有类的方法名
     ObjMap *allModules;
+    ObjString *smallStrings[SMALL_STRING_NUM]; // 空串和单字节串，常驻的根，见InitSmallStrings
+    StringTable strings; // 字符串驻留表，标识符、常量、map的key和模块名都在此驻留
     ObjThread *curThread; // 当前正在执行的线程
 
     Class *classOfClass;
     Class *objectClass;
     Class *mapClass;
+    Class *setClass;
     Class *rangeClass;
     Class *listClass;
     Class *fnClass;
@@ -58,6 +70,7 @@ struct vm {
     Class *boolClass;
     Class *numClass;
     Class *threadClass;
+    Class *stringBuilderClass; // 实例是换了类的ObjList，不可被继承
 
     // 临时的根对象集合，存储临时需要被GC保留的对象，避免回收
     ObjHeader *tmpRoots[MAX_TEMP_ROOTS_NUM];
@@ -66,6 +79,10 @@ struct vm {
     // 用于存储存活对象
     Gray grays;
     Configuration config;
+    boolean compactPending; // 已请求在下一个安全点整理堆
+    boolean gcPending; // 分配量超过阈值，已请求在下一个安全点GC
+    uint32_t gcPauseDepth; // 暂停GC的嵌套层数，大于0时安全点不回收(超出堆上限除外)
+    GCStats gcStats; // GC统计
 };
 
 void InitVM(VM *vm);